@@ -84,7 +84,73 @@ class AllocatorTestSuite {
     }
     StopTimer();
 
-    TestOutput("AllocateThenFreeFixedSize", count, size, timer_);
+    TestOutput("AllocateThenFreeFixedSize", size, count, timer_);
+  }
+
+  /**
+   * Allocate a fixed size in batches of \a batch_size, and then free
+   * them in batches. Compare with AllocateThenFreeFixedSize.
+   * */
+  void AllocateThenFreeBatch(size_t count, size_t size, size_t batch_size) {
+    StartTimer();
+    std::vector<hipc::OffsetPointer> cache(count);
+    for (size_t i = 0; i < count; i += batch_size) {
+      alloc_->AllocateBatch(size, std::min(batch_size, count - i),
+                            cache.data() + i);
+    }
+    for (size_t i = 0; i < count; i += batch_size) {
+      alloc_->FreeBatch(std::min(batch_size, count - i), cache.data() + i);
+    }
+    StopTimer();
+
+    TestOutput("AllocateThenFreeBatch", size, count, timer_);
+  }
+
+  /**
+   * Allocate \a count pages aligned to \a alignment and then free them.
+   * Also reports the bytes of padding per page, compared to allocating
+   * the same pages without alignment.
+   * */
+  void AllocateThenFreeAligned(size_t count, size_t size, size_t alignment) {
+    std::vector<Pointer> cache(count);
+    size_t unaligned_size = AllocatedSizeOfWindow(cache, size, 0);
+    size_t aligned_size = AllocatedSizeOfWindow(cache, size, alignment);
+
+    StartTimer();
+    for (size_t i = 0; i < count; ++i) {
+      cache[i] = alloc_->Allocate(size, alignment);
+    }
+    for (size_t i = 0; i < count; ++i) {
+      alloc_->Free(cache[i]);
+    }
+    StopTimer();
+
+    TestOutput("AllocateThenFreeAligned", size, count, timer_);
+    if (omp_get_thread_num() == 0) {
+      double padding = ((double)aligned_size - (double)unaligned_size) /
+        (double)(count * omp_get_num_threads());
+      HILOG(kInfo, "AlignmentPadding,{},{},{},{}",
+            alloc_type_, size, alignment, padding)
+    }
+  }
+
+  /** Get the bytes allocated for a window of (aligned) pages */
+  size_t AllocatedSizeOfWindow(std::vector<Pointer> &window,
+                               size_t size, size_t alignment) {
+    size_t alloc_size = 0;
+#pragma omp barrier
+    for (size_t i = 0; i < window.size(); ++i) {
+      window[i] = alloc_->Allocate(size, alignment);
+    }
+#pragma omp barrier
+    if (omp_get_thread_num() == 0) {
+      alloc_size = alloc_->GetCurrentlyAllocatedSize();
+    }
+#pragma omp barrier
+    for (size_t i = 0; i < window.size(); ++i) {
+      alloc_->Free(window[i]);
+    }
+    return alloc_size;
   }
 
   void seq(std::vector<size_t> &vec, size_t rep, size_t count) {
@@ -123,6 +189,83 @@ class AllocatorTestSuite {
     TestOutput("AllocateAndFreeRandomWindow", 0, count, timer_);
   }
 
+  /**
+   * Allocate \a count pages of uniformly random sizes up to \a max_size,
+   * and then free them. Also reports the bytes wasted by rounding
+   * requests up to a size class, as a percentage of the bytes requested.
+   * */
+  void AllocateThenFreeRandomSizes(size_t count, size_t max_size) {
+    std::mt19937 rng(23522523 + omp_get_thread_num());
+    std::uniform_int_distribution<size_t> dist(1, max_size);
+    std::vector<size_t> sizes(count);
+    size_t requested = 0;
+    for (size_t i = 0; i < count; ++i) {
+      sizes[i] = dist(rng);
+      requested += sizes[i];
+    }
+    std::vector<Pointer> cache(count);
+
+    StartTimer();
+    for (size_t i = 0; i < count; ++i) {
+      cache[i] = alloc_->Allocate(sizes[i]);
+    }
+#pragma omp barrier
+    size_t allocated = 0;
+    if (omp_get_thread_num() == 0) {
+      allocated = alloc_->GetCurrentlyAllocatedSize();
+    }
+    for (size_t i = 0; i < count; ++i) {
+      alloc_->Free(cache[i]);
+    }
+    StopTimer();
+
+    TestOutput("AllocateThenFreeRandomSizes", max_size, count, timer_);
+    if (omp_get_thread_num() == 0 && allocated) {
+      requested *= omp_get_num_threads();
+      double wasted = ((double)allocated - (double)requested) /
+        (double)requested * 100;
+      HILOG(kInfo, "WastedBytes,{},{},{},{}%",
+            alloc_type_, max_size, allocated - requested, wasted)
+    }
+  }
+
+  /**
+   * Alternate between phases of differently-sized pages, so pages freed
+   * in one phase can only be re-used by the next after coalescing.
+   * Reports the peak footprint of the allocator's backing region.
+   * */
+  void AllocateAndFreeFragmented(size_t num_phases) {
+    std::vector<size_t> phase_sizes = {
+      MEGABYTES(1), KILOBYTES(4), KILOBYTES(64), 256, MEGABYTES(2) + 1
+    };
+    size_t phase_bytes = MEGABYTES(64);
+    auto page_alloc = dynamic_cast<hipc::ScalablePageAllocator*>(alloc_);
+    size_t peak_footprint = 0;
+    std::vector<Pointer> window;
+
+    StartTimer();
+    for (size_t phase = 0; phase < num_phases; ++phase) {
+      size_t size = phase_sizes[phase % phase_sizes.size()];
+      size_t count = phase_bytes / size;
+      window.resize(count);
+      for (size_t i = 0; i < count; ++i) {
+        window[i] = alloc_->Allocate(size);
+      }
+#pragma omp barrier
+      if (page_alloc && omp_get_thread_num() == 0) {
+        peak_footprint = std::max(peak_footprint,
+                                  page_alloc->GetFootprint());
+      }
+      for (size_t i = 0; i < count; ++i) {
+        alloc_->Free(window[i]);
+      }
+    }
+    StopTimer();
+
+    TestOutput("AllocateAndFreeFragmented", peak_footprint,
+               num_phases, timer_);
+  }
+
   /**====================================
    * Test Helpers
    * ===================================*/
@@ -151,7 +294,8 @@ class AllocatorTestSuite {
     if (rank != 0) { return; }
     int nthreads = omp_get_num_threads();
     double count = (double) count_per_rank * nthreads;
-    HILOG(kInfo, "Time: {} msec, {} KOps",
+    HILOG(kInfo, "{},{},{},{},{},{}",
+          test_name, alloc_type_, nthreads, obj_size,
           t.GetMsec(), count / t.GetMsec());
   }
 };
@@ -210,11 +354,27 @@ void AllocatorTest(AllocatorType alloc_type,
   Allocator *alloc = Pretest<BackendT, AllocT>(
     backend_type, std::forward<Args>(args)...);
   // Allocate many and then free many
-  /*AllocatorTestSuite(alloc_type, alloc).AllocateThenFreeFixedSize(
-    ops, KILOBYTES(1));*/
+  AllocatorTestSuite(alloc_type, alloc).AllocateThenFreeFixedSize(
+    ops, KILOBYTES(1));
+  // Allocate many and then free many in batches
+  AllocatorTestSuite(alloc_type, alloc).AllocateThenFreeBatch(
+    ops, KILOBYTES(1), 64);
   // Allocate and free immediately
-  /*AllocatorTestSuite(alloc_type, alloc).AllocateAndFreeFixedSize(
-    ops, KILOBYTES(1));*/
+  AllocatorTestSuite(alloc_type, alloc).AllocateAndFreeFixedSize(
+    ops, 64);
+  AllocatorTestSuite(alloc_type, alloc).AllocateAndFreeFixedSize(
+    ops, KILOBYTES(1));
+  // Allocate random sizes
+  AllocatorTestSuite(alloc_type, alloc).AllocateThenFreeRandomSizes(
+    ops, KILOBYTES(16));
+  // Allocate aligned pages
+  size_t aligned_ops = std::min<size_t>(ops, 1024);
+  AllocatorTestSuite(alloc_type, alloc).AllocateThenFreeAligned(
+    aligned_ops, 256, 64);
+  AllocatorTestSuite(alloc_type, alloc).AllocateThenFreeAligned(
+    aligned_ops, KILOBYTES(4), KILOBYTES(4));
+  AllocatorTestSuite(alloc_type, alloc).AllocateThenFreeAligned(
+    aligned_ops / 16, KILOBYTES(64), MEGABYTES(2));
   if (alloc_type != AllocatorType::kStackAllocator) {
     // Allocate and free randomly
     AllocatorTestSuite(alloc_type, alloc).AllocateAndFreeRandomWindow(
@@ -223,17 +383,128 @@ void AllocatorTest(AllocatorType alloc_type,
   Posttest();
 }
 
-int main(int argc, char **argv) {
-  if (argc != 4) {
-    HELOG(kFatal, "Usage: allocator [nthreads] [alloc] [ops]");
-    return 1;
+/**
+ * Compare the fixed page allocator against the scalable page allocator
+ * for pools of \a size objects.
+ * */
+void FixedPageTest(size_t ops, size_t size) {
+  Allocator *alloc =
+    Pretest<hipc::PosixShmMmap, hipc::FixedPageAllocator>(
+      MemoryBackendType::kPosixShmMmap, size);
+  AllocatorTestSuite(AllocatorType::kFixedPageAllocator, alloc)
+    .AllocateThenFreeFixedSize(ops, size);
+  AllocatorTestSuite(AllocatorType::kFixedPageAllocator, alloc)
+    .AllocateAndFreeFixedSize(ops, size);
+  Posttest();
+  alloc = Pretest<hipc::PosixShmMmap, hipc::ScalablePageAllocator>(
+    MemoryBackendType::kPosixShmMmap);
+  AllocatorTestSuite(AllocatorType::kScalablePageAllocator, alloc)
+    .AllocateThenFreeFixedSize(ops, size);
+  AllocatorTestSuite(AllocatorType::kScalablePageAllocator, alloc)
+    .AllocateAndFreeFixedSize(ops, size);
+  Posttest();
+}
+
+/**
+ * Measure the peak footprint of the page allocator under fragmentation.
+ * Coalescing is triggered once \a trigger bytes are being wasted.
+ * */
+void FragmentationTest(size_t trigger, size_t num_phases) {
+  size_t backend_size = MemoryManager::GetDefaultBackendSize();
+  Allocator *alloc =
+    Pretest<hipc::PosixShmMmap, hipc::ScalablePageAllocator>(
+      MemoryBackendType::kPosixShmMmap,
+      hshm::RealNumber(trigger, backend_size), MEGABYTES(16));
+  AllocatorTestSuite(AllocatorType::kScalablePageAllocator, alloc)
+    .AllocateAndFreeFragmented(num_phases);
+  Posttest();
+}
+
+/** Output a CSV row for a pointer conversion test */
+void ConvertOutput(const std::string &test_name, size_t num_allocs,
+                   size_t count_per_rank, Timer &t) {
+  int nthreads = omp_get_num_threads();
+  double count = (double) count_per_rank * nthreads;
+  HILOG(kInfo, "{},{},{},{},{},{}",
+        test_name, "hipc::MemoryManager", nthreads, num_allocs,
+        t.GetMsec(), count / t.GetMsec());
+}
+
+/**
+ * Measure the cost of finding the allocator of a process-specific pointer
+ * when MAX_ALLOCATORS allocators are registered. The range index is
+ * compared against a linear scan of every allocator.
+ * */
+void ConvertTest(size_t ops) {
+  static std::vector<char> region;
+  static std::vector<hipc::StackAllocator> allocs;
+  static std::vector<char*> ptrs;
+  size_t slice_size = KILOBYTES(64);
+  int rank = omp_get_thread_num();
+  auto mem_mngr = HERMES_MEMORY_MANAGER;
+  Timer t;
+
+  // Fill every free slot of the registry, skipping the root allocator
+  if (rank == 0) {
+    allocator_id_t root_id = HERMES_MEMORY_REGISTRY_REF.root_allocator_id_;
+    region.resize(MAX_ALLOCATORS * slice_size);
+    allocs = std::vector<hipc::StackAllocator>(MAX_ALLOCATORS);
+    for (uint32_t i = 0; i < MAX_ALLOCATORS; ++i) {
+      allocator_id_t alloc_id(i / 4, i % 4);
+      if (alloc_id == root_id) { continue; }
+      allocs[i].shm_init(alloc_id, 0,
+                         region.data() + i * slice_size, slice_size);
+      mem_mngr->RegisterAllocator(&allocs[i]);
+    }
+    std::mt19937_64 rng(23522);
+    ptrs.resize(ops);
+    for (char *&ptr : ptrs) {
+      ptr = region.data() + rng() % region.size();
+    }
   }
+#pragma omp barrier
 
-  int nthreads = std::stoi(argv[1]);
-  std::string alloc = argv[2];
-  size_t ops = hshm::ConfigParse::ParseSize(argv[3]);
+  // Range index
+  size_t found = 0;
+  t.Resume();
+  for (char *ptr : ptrs) {
+    found += mem_mngr->FindAllocator(ptr) != nullptr;
+  }
+  t.Pause();
+#pragma omp barrier
+  if (rank == 0) {
+    ConvertOutput("FindAllocatorRangeIndex", MAX_ALLOCATORS, ops, t);
+  }
 
-  omp_set_dynamic(0);
+  // Linear scan
+  t.Reset();
+  t.Resume();
+  for (char *ptr : ptrs) {
+    for (Allocator *alloc : HERMES_MEMORY_REGISTRY_REF.allocators_) {
+      if (alloc && alloc->ContainsPtr(ptr)) {
+        found += 1;
+        break;
+      }
+    }
+  }
+  t.Pause();
+  volatile size_t sink = found;
+  (void) sink;
+#pragma omp barrier
+  if (rank == 0) {
+    ConvertOutput("FindAllocatorLinearScan", MAX_ALLOCATORS, ops, t);
+    allocator_id_t root_id = HERMES_MEMORY_REGISTRY_REF.root_allocator_id_;
+    for (uint32_t i = 0; i < MAX_ALLOCATORS; ++i) {
+      allocator_id_t alloc_id(i / 4, i % 4);
+      if (alloc_id == root_id) { continue; }
+      mem_mngr->UnregisterAllocator(alloc_id);
+    }
+  }
+#pragma omp barrier
+}
+
+/** Run the benchmarks for \a alloc using \a nthreads threads */
+void RunAllocatorTests(int nthreads, const std::string &alloc, size_t ops) {
 #pragma omp parallel num_threads(nthreads)
   {
 #pragma omp barrier
@@ -252,7 +523,37 @@ int main(int argc, char **argv) {
         AllocatorType::kStackAllocator,
         MemoryBackendType::kPosixShmMmap,
         ops);
+  } else if (alloc == "fixed") {
+    FixedPageTest(ops, 64);
+    FixedPageTest(ops, KILOBYTES(1));
+  } else if (alloc == "fragment") {
+    // Compare against a trigger which only coalesces when out of memory
+    FragmentationTest(MEGABYTES(32), ops);
+    FragmentationTest(MemoryManager::GetDefaultBackendSize(), ops);
+  } else if (alloc == "convert") {
+    ConvertTest(ops);
   }
 #pragma omp barrier
   }
-}
\ No newline at end of file
+}
+
+int main(int argc, char **argv) {
+  if (argc != 4) {
+    HELOG(kFatal, "Usage: allocator [max_nthreads] "
+          "[alloc=scalable|malloc|stack|fixed|fragment|convert] [ops]");
+    return 1;
+  }
+
+  int max_nthreads = std::stoi(argv[1]);
+  std::string alloc = argv[2];
+  size_t ops = hshm::ConfigParse::ParseSize(argv[3]);
+
+  // Scale from 1 to max_nthreads threads in powers of two
+  omp_set_dynamic(0);
+  HILOG(kInfo, "test,alloc,nthreads,size,msec,KOps")
+  int nthreads = 1;
+  for (; nthreads < max_nthreads; nthreads *= 2) {
+    RunAllocatorTests(nthreads, alloc, ops);
+  }
+  RunAllocatorTests(max_nthreads, alloc, ops);
+}
@@ -265,6 +265,76 @@ void FullUnorderedMapTest() {
   UnorderedMapTest<hipc::string, hipc::unordered_map<size_t, hipc::string>>().Test();
 }
 
+/**
+ * Compares starting from scratch, which rebuilds the unordered_map, against
+ * restarting from a FileMmap, which re-attaches the map left in the file.
+ * OUTPUT:
+ * [test_name] [map_type] [internal_type] [time_ms]
+ * */
+void UnorderedMapRestartTest(size_t count) {
+  typedef hipc::unordered_map<size_t, size_t> MapT;
+  std::string path = "/tmp/HermesBenchRestart";
+  allocator_id_t alloc_id(0, 3);
+  auto mem_mngr = HERMES_MEMORY_MANAGER;
+  mem_mngr->UnregisterAllocator(alloc_id);
+  mem_mngr->UnregisterBackend(path);
+
+  // Cold start: create the backend and rebuild the map
+  Timer t_build;
+  t_build.Resume();
+  mem_mngr->CreateBackend<hipc::FileMmap>(MEGABYTES(256), path);
+  Allocator *alloc = mem_mngr->CreateAllocator<hipc::ScalablePageAllocator>(
+    path, alloc_id, sizeof(Pointer));
+  auto map = hipc::make_mptr<MapT>(alloc, 5000);
+  for (size_t i = 0; i < count; ++i) {
+    map->emplace(i, i);
+  }
+  map >> (*alloc->GetCustomHeader<Pointer>());
+  t_build.Pause();
+
+  // Persist the map and drop the mapping
+  reinterpret_cast<hipc::ScalablePageAllocator*>(alloc)->FlushThreadCache();
+  reinterpret_cast<hipc::FileMmap*>(mem_mngr->GetBackend(path))->Checkpoint();
+  mem_mngr->UnregisterAllocator(alloc_id);
+  mem_mngr->UnregisterBackend(path);
+
+  // Warm start: attach the file and find the map
+  Timer t_attach;
+  t_attach.Resume();
+  mem_mngr->AttachBackend(MemoryBackendType::kFileMmap, path);
+  Allocator *alloc2 = mem_mngr->GetAllocator(alloc_id);
+  hipc::mptr<MapT> map2;
+  map2 << (*alloc2->GetCustomHeader<Pointer>());
+  t_attach.Pause();
+
+  // The attached pages are faulted in by their first access
+  Timer t_get;
+  size_t sum = 0;
+  t_get.Resume();
+  for (size_t i = 0; i < count; ++i) {
+    sum += (*map2)[i];
+  }
+  t_get.Pause();
+  volatile size_t sink = sum;
+  (void) sink;
+
+  HIPRINT("{},{},{},{}\n",
+          "RestartRebuild", "hipc::unordered_map", "size_t",
+          t_build.GetMsec())
+  HIPRINT("{},{},{},{}\n",
+          "RestartAttach", "hipc::unordered_map", "size_t",
+          t_attach.GetMsec())
+  HIPRINT("{},{},{},{}\n",
+          "RestartFirstGet", "hipc::unordered_map", "size_t",
+          t_get.GetMsec())
+  mem_mngr->UnregisterAllocator(alloc_id);
+  mem_mngr->DestroyBackend(path);
+}
+
 TEST_CASE("UnorderedMapBenchmark") {
   FullUnorderedMapTest();
 }
+
+TEST_CASE("UnorderedMapRestartBenchmark") {
+  UnorderedMapRestartTest(100000);
+}
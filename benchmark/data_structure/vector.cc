@@ -19,6 +19,7 @@
 // Std
 #include <string>
 #include <vector>
+#include <random>
 
 // hermes
 #include "hermes_shm/data_structures/ipc/string.h"
@@ -323,6 +324,54 @@ class VectorTest {
   }
 };
 
+/**
+ * Random reads over a large vector placed in a \a BackendT backend.
+ * Compares the TLB behavior of regular and huge pages.
+ * OUTPUT:
+ * [test_name] [vec_type] [backend_type] [time_ms]
+ * */
+template<typename BackendT>
+void VectorRandomAccessTest(const std::string &backend_type) {
+  std::string shm_url = "HermesBenchRandomAccess";
+  allocator_id_t alloc_id(0, 2);
+  size_t count = MEGABYTES(512) / sizeof(size_t);
+  size_t num_reads = 10000000;
+  auto mem_mngr = HERMES_MEMORY_MANAGER;
+  mem_mngr->UnregisterAllocator(alloc_id);
+  mem_mngr->UnregisterBackend(shm_url);
+  mem_mngr->CreateBackend<BackendT>(MEGABYTES(576), shm_url);
+  Allocator *alloc = mem_mngr->CreateAllocator<hipc::StackAllocator>(
+    shm_url, alloc_id, 0);
+
+  // Fill the vector and choose the indices to read
+  auto vec = hipc::make_mptr<hipc::vector<size_t>>(alloc);
+  vec->reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    vec->emplace_back(i);
+  }
+  std::mt19937_64 rng(2352352);
+  std::vector<size_t> idxs(num_reads);
+  for (size_t &idx : idxs) {
+    idx = rng() % count;
+  }
+
+  Timer t;
+  size_t sum = 0;
+  t.Resume();
+  for (size_t idx : idxs) {
+    sum += (*vec)[idx];
+  }
+  t.Pause();
+  volatile size_t sink = sum;
+  (void) sink;
+
+  HIPRINT("{},{},{},{}\n",
+          "RandomGet", "hipc::vector", backend_type, t.GetMsec())
+  vec.shm_destroy();
+  mem_mngr->UnregisterAllocator(alloc_id);
+  mem_mngr->DestroyBackend(shm_url);
+}
+
 void FullVectorTest() {
   // std::vector tests
   VectorTest<size_t, std::vector<size_t>>().Test();
@@ -342,3 +391,8 @@ void FullVectorTest() {
 TEST_CASE("VectorBenchmark") {
   FullVectorTest();
 }
+
+TEST_CASE("VectorRandomAccessBenchmark") {
+  VectorRandomAccessTest<hipc::PosixShmMmap>("PosixShmMmap");
+  VectorRandomAccessTest<hipc::PosixShmHugeMmap>("PosixShmHugeMmap");
+}
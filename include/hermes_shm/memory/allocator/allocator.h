@@ -173,6 +173,26 @@ class Allocator {
    * */
   virtual void FreeOffsetNoNullCheck(OffsetPointer p) = 0;
 
+  /**
+   * Allocate \a count regions of \a size size, stored in \a out.
+   * Allocators override this to amortize locking and accounting
+   * across the batch.
+   * */
+  virtual void AllocateBatch(size_t size, size_t count, OffsetPointer *out) {
+    for (size_t i = 0; i < count; ++i) {
+      out[i] = AllocateOffset(size);
+    }
+  }
+
+  /**
+   * Free the \a count regions in \a ptrs. None may be null.
+   * */
+  virtual void FreeBatch(size_t count, OffsetPointer *ptrs) {
+    for (size_t i = 0; i < count; ++i) {
+      FreeOffsetNoNullCheck(ptrs[i]);
+    }
+  }
+
   /**
    * Get the allocator identifier
    * */
@@ -184,6 +204,33 @@ class Allocator {
    * */
   virtual size_t GetCurrentlyAllocatedSize() = 0;
 
+  /**
+   * Get the number of bytes of the allocator's memory which are resident
+   * in RAM. Allocators which don't track this report the allocated size.
+   * */
+  virtual size_t GetResidentSize() {
+    return GetCurrentlyAllocatedSize();
+  }
+
+  /**
+   * Get the number of bytes usable at \a p, which is at least the size
+   * it was allocated with. \a p must not be null.
+   * */
+  virtual size_t GetUsableSize(OffsetPointer p) {
+    (void) p;
+    throw NOT_IMPLEMENTED.format("GetUsableSize");
+  }
+
+  /**
+   * Return the memory of free pages to the OS. Allocators which keep
+   * free pages decide which to release using their decay policy.
+   *
+   * @return the number of bytes released
+   * */
+  virtual size_t Purge() {
+    return 0;
+  }
+
   /**====================================
   * Pointer Allocators
   * ===================================*/
@@ -883,8 +930,23 @@ class Allocator {
    * */
   template<typename T = void>
   HSHM_ALWAYS_INLINE bool ContainsPtr(T *ptr) {
-    return  reinterpret_cast<size_t>(ptr) >=
-        reinterpret_cast<size_t>(buffer_);
+    // Allocators without a buffer (e.g., malloc) address memory directly
+    if (buffer_ == nullptr) {
+      return true;
+    }
+    size_t addr = reinterpret_cast<size_t>(ptr);
+    size_t start = reinterpret_cast<size_t>(buffer_);
+    return start <= addr && addr < start + buffer_size_;
+  }
+
+  /** Get the start of the region this allocator manages */
+  HSHM_ALWAYS_INLINE char* GetBuffer() {
+    return buffer_;
+  }
+
+  /** Get the size of the region this allocator manages */
+  HSHM_ALWAYS_INLINE size_t GetBufferSize() {
+    return buffer_size_;
   }
 };
 
@@ -18,6 +18,7 @@
 #include "stack_allocator.h"
 #include "malloc_allocator.h"
 #include "scalable_page_allocator.h"
+#include "fixed_page_allocator.h"
 
 namespace hshm::ipc {
 
@@ -57,6 +58,15 @@ class AllocatorFactory {
                       backend->data_size_,
                       std::forward<Args>(args)...);
       return alloc;
+    } else if constexpr(std::is_same_v<FixedPageAllocator, AllocT>) {
+      // Fixed Page Allocator
+      auto alloc = std::make_unique<FixedPageAllocator>();
+      alloc->shm_init(alloc_id,
+                      custom_header_size,
+                      backend->data_,
+                      backend->data_size_,
+                      std::forward<Args>(args)...);
+      return alloc;
     } else {
       // Default
       throw std::logic_error("Not a valid allocator");
@@ -90,6 +100,13 @@ class AllocatorFactory {
                                backend->data_size_);
         return alloc;
       }
+      // Fixed Page Allocator
+      case AllocatorType::kFixedPageAllocator: {
+        auto alloc = std::make_unique<FixedPageAllocator>();
+        alloc->shm_deserialize(backend->data_,
+                               backend->data_size_);
+        return alloc;
+      }
       default: return nullptr;
     }
   }
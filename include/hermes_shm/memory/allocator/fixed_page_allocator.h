@@ -0,0 +1,157 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef HERMES_MEMORY_ALLOCATOR_FIXED_PAGE_ALLOCATOR_H_
+#define HERMES_MEMORY_ALLOCATOR_FIXED_PAGE_ALLOCATOR_H_
+
+#include "allocator.h"
+#include "heap.h"
+#include "hermes_shm/constants/macros.h"
+
+namespace hshm::ipc {
+
+/**
+ * A free page. The free list is threaded through the pages themselves,
+ * so allocated pages have no header.
+ * */
+struct FixedFreePage {
+  uint64_t next_;  /**< Tagged index of the next free page */
+};
+
+struct FixedPageAllocatorHeader : public AllocatorHeader {
+  /** Tag (upper 32 bits) and index + 1 (lower 32 bits) of the free list */
+  alignas(HSHM_CACHE_LINE_SIZE) std::atomic<uint64_t> free_head_;
+  alignas(HSHM_CACHE_LINE_SIZE) HeapAllocator heap_;
+  std::atomic<size_t> total_alloc_;
+  size_t region_off_;
+  size_t page_size_;
+  size_t page_align_;
+
+  FixedPageAllocatorHeader() = default;
+
+  void Configure(allocator_id_t alloc_id,
+                 size_t custom_header_size,
+                 size_t region_off,
+                 size_t region_size,
+                 size_t page_size,
+                 size_t page_align) {
+    AllocatorHeader::Configure(alloc_id, AllocatorType::kFixedPageAllocator,
+                               custom_header_size);
+    free_head_ = 0;
+    heap_.shm_init(region_off, region_size);
+    total_alloc_ = 0;
+    region_off_ = region_off;
+    page_size_ = page_size;
+    page_align_ = page_align;
+  }
+};
+
+/**
+ * Divides a backend into pages of a single size. Allocation and free are
+ * O(1) pushes and pops on a lock-free free list. Suited for pools of
+ * uniform objects, such as list entries and queue nodes.
+ * */
+class FixedPageAllocator : public Allocator {
+ public:
+  FixedPageAllocatorHeader *header_;
+  size_t page_size_;
+  size_t region_off_;
+
+ public:
+  /**
+   * Allocator constructor
+   * */
+  FixedPageAllocator()
+  : header_(nullptr) {}
+
+  /**
+   * Get the ID of this allocator from shared memory
+   * */
+  allocator_id_t &GetId() override {
+    return header_->allocator_id_;
+  }
+
+  /**
+   * Initialize the allocator in shared memory. Every allocation
+   * reserves \a page_size bytes.
+   * */
+  void shm_init(allocator_id_t id,
+                size_t custom_header_size,
+                char *buffer,
+                size_t buffer_size,
+                size_t page_size = 64);
+
+  /**
+   * Attach an existing allocator from shared memory
+   * */
+  void shm_deserialize(char *buffer,
+                       size_t buffer_size) override;
+
+  /**
+   * Allocate a page. \a size must not exceed the page size.
+   * */
+  OffsetPointer AllocateOffset(size_t size) override;
+
+  /**
+   * Allocate a page aligned to \a alignment. Only alignments which
+   * every page already satisfies are supported.
+   * */
+  OffsetPointer AlignedAllocateOffset(size_t size, size_t alignment) override;
+
+  /**
+   * Reallocate \a p pointer to \a new_size new size. Pages cannot grow,
+   * so this only succeeds if \a new_size fits in a page.
+   *
+   * @return whether or not the pointer p was changed
+   * */
+  OffsetPointer ReallocateOffsetNoNullCheck(
+    OffsetPointer p, size_t new_size) override;
+
+  /**
+   * Free \a ptr pointer. Null check is performed elsewhere.
+   * */
+  void FreeOffsetNoNullCheck(OffsetPointer p) override;
+
+  /**
+   * Get the current amount of data allocated. Can be used for leak
+   * checking.
+   * */
+  size_t GetCurrentlyAllocatedSize() override;
+
+  /**
+   * Get the number of bytes usable at \a p, which is the page size.
+   * */
+  size_t GetUsableSize(OffsetPointer p) override;
+
+  /** Get the size of each page */
+  size_t GetPageSize() {
+    return page_size_;
+  }
+
+ private:
+  /** Get the free page at index \a idx */
+  HSHM_ALWAYS_INLINE FixedFreePage* GetFreePage(uint64_t idx) {
+    return reinterpret_cast<FixedFreePage*>(
+      buffer_ + region_off_ + idx * page_size_);
+  }
+
+  /** Pop a page from the free list */
+  OffsetPointer PopFreePage();
+
+  /** Push a page to the free list */
+  void PushFreePage(OffsetPointer p);
+};
+
+}  // namespace hshm::ipc
+
+#endif  // HERMES_MEMORY_ALLOCATOR_FIXED_PAGE_ALLOCATOR_H_
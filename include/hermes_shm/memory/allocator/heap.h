@@ -37,12 +37,35 @@ struct HeapAllocator {
 
   /** Allocate off heap */
   HSHM_ALWAYS_INLINE OffsetPointer AllocateOffset(size_t size) {
-    size_t off = heap_off_.fetch_add(size);
-    if (off + size > heap_size_) {
+    OffsetPointer p = TryAllocateOffset(size);
+    if (p.IsNull()) {
       throw OUT_OF_MEMORY.format(size, heap_size_);
     }
+    return p;
+  }
+
+  /**
+   * Allocate off heap. Returns null if the heap is exhausted. A failed
+   * allocation leaves the heap unchanged.
+   * */
+  HSHM_ALWAYS_INLINE OffsetPointer TryAllocateOffset(size_t size) {
+    size_t off = heap_off_.load(std::memory_order_relaxed);
+    do {
+      if (off + size > heap_size_) {
+        return OffsetPointer::GetNull();
+      }
+    } while (!heap_off_.compare_exchange_weak(off, off + size));
     return OffsetPointer(off);
   }
+
+  /**
+   * Return [off, off + size) to the heap. Only succeeds if the region
+   * is at the top of the heap.
+   * */
+  HSHM_ALWAYS_INLINE bool FreeTail(OffsetPointer off, size_t size) {
+    size_t top = off.load() + size;
+    return heap_off_.compare_exchange_strong(top, off.load());
+  }
 };
 
 }  // namespace hshm::ipc
@@ -93,6 +93,11 @@ class MallocAllocator : public Allocator {
    * checking.
    * */
   size_t GetCurrentlyAllocatedSize() override;
+
+  /**
+   * Get the number of bytes usable at \a p.
+   * */
+  size_t GetUsableSize(OffsetPointer p) override;
 };
 
 }  // namespace hshm::ipc
@@ -14,6 +14,7 @@
 #define HERMES_INCLUDE_HERMES_MEMORY_ALLOCATOR_MP_PAGE_H_
 
 #include "hermes_shm/data_structures/ipc/iqueue.h"
+#include <algorithm>
 
 namespace hshm::ipc {
 
@@ -34,6 +35,48 @@ struct MpPage {
   HSHM_ALWAYS_INLINE bool IsAllocated() const {
     return flags_.All(0x1);
   }
+
+  /** Get the header at the start of the page containing this header */
+  HSHM_ALWAYS_INLINE MpPage* GetPageStart() {
+    return reinterpret_cast<MpPage*>(reinterpret_cast<char*>(this) - off_);
+  }
+
+  /**
+   * The number of bytes needed in a page for \a size bytes aligned to
+   * \a alignment, including the page header.
+   * */
+  HSHM_ALWAYS_INLINE static size_t GetAlignedPageSize(size_t size,
+                                                      size_t alignment) {
+    return size + std::max(alignment, sizeof(MpPage));
+  }
+
+  /**
+   * Place an allocation aligned to \a alignment within \a page, which
+   * must itself be aligned to sizeof(MpPage). If the data does not
+   * directly follow the page header, a second header is placed right
+   * before the data, whose off_ points back to \a page.
+   *
+   * @return the header which directly precedes the aligned data
+   * */
+  HSHM_ALWAYS_INLINE static MpPage* PlaceAligned(MpPage *page,
+                                                 size_t alignment) {
+    size_t start = reinterpret_cast<size_t>(page);
+    size_t data = NextAligned(start + sizeof(MpPage), alignment);
+    if (data == start + sizeof(MpPage)) {
+      return page;
+    }
+    auto hdr = reinterpret_cast<MpPage*>(data - sizeof(MpPage));
+    hdr->flags_.Clear();
+    hdr->SetAllocated();
+    hdr->off_ = static_cast<uint32_t>(data - sizeof(MpPage) - start);
+    hdr->page_size_ = page->page_size_ - hdr->off_;
+    return hdr;
+  }
+
+  /** Round \a addr up to a multiple of \a alignment (a power of two) */
+  HSHM_ALWAYS_INLINE static size_t NextAligned(size_t addr, size_t alignment) {
+    return (addr + alignment - 1) & ~(alignment - 1);
+  }
 };
 
 }  // namespace hshm::ipc
@@ -0,0 +1,86 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HERMES_MEMORY_ALLOCATOR_PAGE_PURGE_H_
+#define HERMES_MEMORY_ALLOCATOR_PAGE_PURGE_H_
+
+#include <sys/mman.h>
+#include <chrono>
+#include <vector>
+#include <hermes_shm/memory/memory.h>
+#include <hermes_shm/introspect/system_info.h>
+
+namespace hshm::ipc {
+
+/** Returns the memory of free pages to the OS */
+struct PagePurge {
+  /**
+   * Release the OS pages which lie entirely within [ptr, ptr + size).
+   * The contents of those pages are lost.
+   *
+   * @return the number of bytes released
+   * */
+  static size_t Release(char *ptr, size_t size) {
+    size_t os_page_size = HERMES_SYSTEM_INFO->page_size_;
+    size_t start = MemoryAlignment::AlignTo(os_page_size,
+                                            reinterpret_cast<size_t>(ptr));
+    size_t end = (reinterpret_cast<size_t>(ptr) + size) &
+      ~(os_page_size - 1);
+    if (end <= start) {
+      return 0;
+    }
+    // Shared mappings (e.g., shm_open) only drop their backing pages
+    // with MADV_REMOVE. Private mappings only support MADV_DONTNEED.
+    void *region = reinterpret_cast<void*>(start);
+    if (madvise(region, end - start, MADV_REMOVE) != 0 &&
+        madvise(region, end - start, MADV_DONTNEED) != 0) {
+      return 0;
+    }
+    return end - start;
+  }
+
+  /**
+   * Get the number of bytes of [ptr, ptr + size) which are resident
+   * in memory.
+   * */
+  static size_t GetResidentSize(char *ptr, size_t size) {
+    size_t os_page_size = HERMES_SYSTEM_INFO->page_size_;
+    size_t start = reinterpret_cast<size_t>(ptr) & ~(os_page_size - 1);
+    size_t end = MemoryAlignment::AlignTo(
+      os_page_size, reinterpret_cast<size_t>(ptr) + size);
+    size_t num_pages = (end - start) / os_page_size;
+    size_t resident = 0;
+    // Query the pages in chunks to bound the size of the vector
+    std::vector<unsigned char> vec(std::min<size_t>(num_pages, 65536));
+    for (size_t i = 0; i < num_pages; i += vec.size()) {
+      size_t count = std::min(vec.size(), num_pages - i);
+      void *region = reinterpret_cast<void*>(start + i * os_page_size);
+      if (mincore(region, count * os_page_size, vec.data()) != 0) {
+        continue;
+      }
+      for (size_t j = 0; j < count; ++j) {
+        resident += vec[j] & 1;
+      }
+    }
+    return resident * os_page_size;
+  }
+
+  /** Get the current time in milliseconds, on a clock shared by processes */
+  static size_t GetTimeMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+};
+
+}  // namespace hshm::ipc
+
+#endif  // HERMES_MEMORY_ALLOCATOR_PAGE_PURGE_H_
@@ -22,6 +22,7 @@
 #include "hermes_shm/data_structures/ipc/pair.h"
 #include <hermes_shm/memory/allocator/stack_allocator.h>
 #include "mp_page.h"
+#include "page_purge.h"
 
 namespace hshm::ipc {
 
@@ -83,11 +84,135 @@ struct FreeListSet {
   std::atomic<uint16_t> *rr_alloc_;
 };
 
+/** A per-thread stack of free pages belonging to a single size class */
+template<size_t DEPTH>
+struct PageMagazine {
+  MpPage *pages_[DEPTH];
+  size_t count_ = 0;
+
+  /** Whether the magazine has no pages */
+  HSHM_ALWAYS_INLINE bool IsEmpty() const {
+    return count_ == 0;
+  }
+
+  /** Whether the magazine cannot hold any more pages */
+  HSHM_ALWAYS_INLINE bool IsFull() const {
+    return count_ == DEPTH;
+  }
+
+  /** Push a page onto the magazine */
+  HSHM_ALWAYS_INLINE void push(MpPage *page) {
+    pages_[count_++] = page;
+  }
+
+  /** Pop a page from the magazine */
+  HSHM_ALWAYS_INLINE MpPage* pop() {
+    return pages_[--count_];
+  }
+};
+
+/**
+ * The number of bytes allocated by a single thread. Stored in shared
+ * memory so that every process can compute the total allocated size.
+ * */
+struct ThreadAllocCounter {
+  std::atomic<size_t> total_alloc_;
+  OffsetPointer next_;
+};
+
+/**
+ * Stored after the header of a large free page, so idle pages can be
+ * returned to the OS. Only valid while the page is free.
+ * */
+struct MpPageFreeInfo {
+  size_t free_time_ms_;  /**< When the page was freed */
+  size_t purged_;        /**< Whether the page was returned to the OS */
+};
+
+/**
+ * The process-local front-end cache of a single thread. Only the owning
+ * thread modifies the magazines and counter, so no synchronization is
+ * needed to allocate or free a page that hits the cache.
+ * */
+template<size_t NUM_MAGAZINES, size_t DEPTH>
+struct ThreadPageCache {
+  PageMagazine<DEPTH> mags_[NUM_MAGAZINES];
+  ThreadAllocCounter *counter_;
+
+  /** Constructor */
+  explicit ThreadPageCache(ThreadAllocCounter *counter)
+  : counter_(counter) {}
+
+  /** Add to the allocation counter */
+  HSHM_ALWAYS_INLINE void AddAlloc(size_t size) {
+    std::atomic<size_t> &total_alloc = counter_->total_alloc_;
+    total_alloc.store(total_alloc.load(std::memory_order_relaxed) + size,
+                      std::memory_order_relaxed);
+  }
+
+  /** Subtract from the allocation counter */
+  HSHM_ALWAYS_INLINE void SubAlloc(size_t size) {
+    std::atomic<size_t> &total_alloc = counter_->total_alloc_;
+    total_alloc.store(total_alloc.load(std::memory_order_relaxed) - size,
+                      std::memory_order_relaxed);
+  }
+};
+
+/**
+ * The size classes of the page allocator. Each power of two between the
+ * minimum and maximum cached size is split into 4 evenly-spaced classes
+ * (e.g., 1024, 1280, 1536, 1792, 2048). Sizes exclude the page header.
+ * */
+struct PageSizeClasses {
+  /** The power-of-two exponent of the smallest class (64 bytes) */
+  static const size_t min_exp_ = 6;
+  /** The power-of-two exponent of the largest class (16MB) */
+  static const size_t max_exp_ = 24;
+  /** The log2 of the number of classes per power of two */
+  static const size_t steps_exp_ = 2;
+  /** The number of classes per power of two */
+  static const size_t steps_ = 1 << steps_exp_;
+  /** The number of classes */
+  static const size_t count_ = (max_exp_ - min_exp_) * steps_ + 1;
+  /** The smallest class size */
+  static const size_t min_size_ = (size_t)1 << min_exp_;
+  /** The largest class size */
+  static const size_t max_size_ = (size_t)1 << max_exp_;
+
+  /** Get the size of class \a cls */
+  HSHM_ALWAYS_INLINE static constexpr size_t GetSize(size_t cls) {
+    if (cls == 0) {
+      return min_size_;
+    }
+    size_t exp = min_exp_ + (cls - 1) / steps_;
+    size_t step = (cls - 1) % steps_ + 1;
+    return ((size_t)1 << exp) + (step << (exp - steps_exp_));
+  }
+
+  /** Get the smallest class which fits \a size. Requires size <= max. */
+  HSHM_ALWAYS_INLINE static constexpr size_t GetClass(size_t size) {
+    if (size <= min_size_) {
+      return 0;
+    }
+    // size is in (2^exp, 2^(exp + 1)]
+    size_t exp = 63 - __builtin_clzll(size - 1);
+    size_t step = ((size - 1) >> (exp - steps_exp_)) - steps_ + 1;
+    return (exp - min_exp_) * steps_ + step;
+  }
+};
+
 struct ScalablePageAllocatorHeader : public AllocatorHeader {
+  /** The layout version. Bumped whenever the header or free lists change. */
+  static constexpr uint32_t kVersion = 3;
+  uint32_t version_;
   ShmArchive<vector<FreeListSetIpc>> free_lists_;
   std::atomic<size_t> total_alloc_;
+  AtomicOffsetPointer thread_counters_;
   size_t coalesce_trigger_;
   size_t coalesce_window_;
+  std::atomic<size_t> last_coalesce_;
+  size_t purge_decay_ms_;
+  std::atomic<size_t> last_purge_ms_;
 
   ScalablePageAllocatorHeader() = default;
 
@@ -96,14 +221,20 @@ struct ScalablePageAllocatorHeader : public AllocatorHeader {
                  Allocator *alloc,
                  size_t buffer_size,
                  RealNumber coalesce_trigger,
-                 size_t coalesce_window) {
+                 size_t coalesce_window,
+                 size_t purge_decay_ms) {
     AllocatorHeader::Configure(alloc_id,
                                AllocatorType::kScalablePageAllocator,
                                custom_header_size);
+    version_ = kVersion;
     HSHM_MAKE_AR0(free_lists_, alloc)
     total_alloc_ = 0;
+    thread_counters_.SetNull();
     coalesce_trigger_ = (coalesce_trigger * buffer_size).as_int();
     coalesce_window_ = coalesce_window;
+    last_coalesce_ = 0;
+    purge_decay_ms_ = purge_decay_ms;
+    last_purge_ms_ = 0;
   }
 };
 
@@ -112,28 +243,50 @@ class ScalablePageAllocator : public Allocator {
   ScalablePageAllocatorHeader *header_;
   std::vector<FreeListSet> free_lists_;
   StackAllocator alloc_;
-  /** The power-of-two exponent of the minimum size that can be cached */
-  static const size_t min_cached_size_exp_ = 6;
   /** The minimum size that can be cached directly (64 bytes) */
   static const size_t min_cached_size_ =
-    (1 << min_cached_size_exp_) + sizeof(MpPage);
-  /** The power-of-two exponent of the minimum size that can be cached (16KB) */
-  static const size_t max_cached_size_exp_ = 24;
-  /** The maximum size that can be cached directly */
+    PageSizeClasses::min_size_ + sizeof(MpPage);
+  /** The maximum size that can be cached directly (16MB) */
   static const size_t max_cached_size_ =
-    (1 << max_cached_size_exp_) + sizeof(MpPage);
+    PageSizeClasses::max_size_ + sizeof(MpPage);
   /** The number of well-defined caches */
-  static const size_t num_caches_ =
-    max_cached_size_exp_ - min_cached_size_exp_ + 1;
+  static const size_t num_caches_ = PageSizeClasses::count_;
   /** An arbitrary free list */
   static const size_t num_free_lists_ = num_caches_ + 1;
+  /** The size classes with a per-thread magazine (up to 64KB) */
+  static const size_t num_magazines_ =
+    PageSizeClasses::GetClass(KILOBYTES(64)) + 1;
+  /** The number of pages a per-thread magazine can hold */
+  static const size_t magazine_depth_ = 32;
+  /** The number of pages moved between a magazine and a shared lane */
+  static const size_t magazine_batch_ = magazine_depth_ / 2;
+  /** The maximum number of threads with a front-end cache */
+  static const size_t max_thread_caches_ = 256;
+
+ public:
+  typedef PageMagazine<magazine_depth_> Magazine;
+  typedef ThreadPageCache<num_magazines_, magazine_depth_> ThreadCache;
+
+ private:
+  /** The front-end caches, indexed by the thread's cache slot */
+  std::atomic<ThreadCache*> thread_caches_[max_thread_caches_];
 
  public:
   /**
    * Allocator constructor
    * */
   ScalablePageAllocator()
-    : header_(nullptr) {}
+    : header_(nullptr) {
+    for (std::atomic<ThreadCache*> &tcache : thread_caches_) {
+      tcache = nullptr;
+    }
+  }
+
+  /**
+   * Allocator destructor. Pages held in front-end caches are not returned
+   * to shared memory.
+   * */
+  ~ScalablePageAllocator() override;
 
   /**
    * Get the ID of this allocator from shared memory
@@ -143,14 +296,18 @@ class ScalablePageAllocator : public Allocator {
   }
 
   /**
-   * Initialize the allocator in shared memory
+   * Initialize the allocator in shared memory. Large free pages are
+   * returned to the OS once they have been free for \a purge_decay_ms.
+   * Frees check for such pages at most once per decay period. If the
+   * decay is 0, pages are only returned when Purge() is called.
    * */
   void shm_init(allocator_id_t id,
                 size_t custom_header_size,
                 char *buffer,
                 size_t buffer_size,
                 RealNumber coalesce_trigger = RealNumber(1, 5),
-                size_t coalesce_window = MEGABYTES(1));
+                size_t coalesce_window = MEGABYTES(1),
+                size_t purge_decay_ms = 10000);
 
   /**
    * Attach an existing allocator from shared memory
@@ -191,6 +348,81 @@ class ScalablePageAllocator : public Allocator {
   OffsetPointer AllocateOffset(size_t size) override;
 
  private:
+  /** Allocate a page of \a size_mp bytes in size class \a exp */
+  MpPage* AllocatePage(size_t size_mp, size_t exp);
+
+ public:
+  /**
+   * Get the number of bytes of the backing region that have been carved
+   * into pages. Coalescing can shrink this.
+   * */
+  size_t GetFootprint() {
+    return alloc_.heap_->heap_off_.load();
+  }
+
+  /** Return the calling thread's cached pages to the shared free lists */
+  void FlushThreadCache();
+
+ private:
+  /** Carve a single page from the stack. Returns nullptr if exhausted. */
+  MpPage* AllocateFromStack(size_t size_mp);
+
+  /**
+   * Coalesce the free lists if enough space is being wasted, and then
+   * search for a page which fits \a size_mp. If \a force is set, the
+   * trigger and window are ignored.
+   * */
+  MpPage* CheckCoalesce(size_t size_mp, bool force);
+
+  /**
+   * Merge adjacent free pages across all shared free lists. Merged pages
+   * at the top of the stack are returned to it.
+   * */
+  void Coalesce();
+
+  /** Find the first fit in any lane of the arbitrary free list */
+  MpPage* FindFirstFitAll(size_t size_mp);
+
+  /**
+   * Get the free list set a free page belongs to. Pages which are exactly
+   * a cached size go to that size's list, others go to the arbitrary list.
+   * */
+  HSHM_ALWAYS_INLINE size_t GetFreeListSetId(size_t page_size) {
+    size_t exp;
+    size_t round = RoundUp(page_size, exp);
+    if (exp < num_caches_ && round == page_size) {
+      return exp;
+    }
+    return num_caches_;
+  }
+
+  /**
+   * Get the front-end cache of the calling thread. Returns nullptr if
+   * there are more live threads than cache slots.
+   * */
+  ThreadCache* GetThreadCache();
+
+  /** Pop a page from the calling thread's magazine for size class \a exp */
+  MpPage* AllocateFromMagazine(ThreadCache &tcache, size_t exp);
+
+  /** Push a free page into the calling thread's magazine */
+  void FreeToMagazine(ThreadCache &tcache, MpPage *page, size_t exp);
+
+  /** Refill an empty magazine with a batch from a shared lane */
+  void RefillMagazine(Magazine &mag, size_t exp);
+
+  /**
+   * Carve a batch of pages from the stack into an empty magazine and pop
+   * one. Returns nullptr if the stack is exhausted.
+   * */
+  MpPage* CarveMagazine(ThreadCache &tcache, size_t size_mp, size_t exp);
+
+  /** Move a batch of pages from a full magazine to a shared lane */
+  void FlushMagazine(Magazine &mag, size_t exp);
+
+  /** Allocate a thread's counter and add it to the shared counter list */
+  ThreadAllocCounter* RegisterThreadCounter();
+
   /** Check if a cached page on this core can be re-used */
   HSHM_ALWAYS_INLINE MpPage* CheckLocalCaches(size_t size_mp, size_t exp) {
     MpPage *page;
@@ -242,6 +474,12 @@ class ScalablePageAllocator : public Allocator {
         DividePage(free_list, fit_page, rem_page, size_mp, 0);
         free_list.dequeue(iter);
         if (rem_page) {
+          // The remainder has been free as long as the page it came from
+          if (IsPurgeable(rem_page->page_size_)) {
+            GetFreeInfo(rem_page)->free_time_ms_ =
+              GetFreeInfo(fit_page)->free_time_ms_;
+            GetFreeInfo(rem_page)->purged_ = 0;
+          }
           free_list.enqueue(rem_page);
         }
         return fit_page;
@@ -315,24 +553,80 @@ class ScalablePageAllocator : public Allocator {
    * */
   void FreeOffsetNoNullCheck(OffsetPointer p) override;
 
+  /**
+   * Allocate \a count pages of \a size size, stored in \a out. Pages
+   * come from the thread's magazine, then from a single free list lane,
+   * and the remainder is carved from the stack in one piece.
+   * */
+  void AllocateBatch(size_t size, size_t count, OffsetPointer *out) override;
+
+  /**
+   * Free the \a count pages in \a ptrs. Consecutive pages of the same
+   * size class are appended to a lane under a single lock.
+   * */
+  void FreeBatch(size_t count, OffsetPointer *ptrs) override;
+
   /**
    * Get the current amount of data allocated. Can be used for leak
    * checking.
    * */
   size_t GetCurrentlyAllocatedSize() override;
 
+  /**
+   * Get the number of bytes of the carved pages which are resident in RAM.
+   * */
+  size_t GetResidentSize() override;
+
+  /**
+   * Get the number of bytes usable at \a p. This includes the rounding
+   * to the page's size class.
+   * */
+  size_t GetUsableSize(OffsetPointer p) override;
+
+  /**
+   * Return the interiors of large pages which have been free for at
+   * least the decay period to the OS.
+   *
+   * @return the number of bytes released
+   * */
+  size_t Purge() override;
+
  private:
-  /** Round a number up to the nearest page size. */
+  /** Whether \a page_size is large enough to be purged */
+  HSHM_ALWAYS_INLINE static bool IsPurgeable(size_t page_size) {
+    return page_size > PageSizeClasses::GetSize(num_magazines_ - 1) +
+      sizeof(MpPage);
+  }
+
+  /** Get the purge info of a free page */
+  HSHM_ALWAYS_INLINE static MpPageFreeInfo* GetFreeInfo(MpPage *page) {
+    return reinterpret_cast<MpPageFreeInfo*>(page + 1);
+  }
+
+  /** Record the time a large page was freed at */
+  HSHM_ALWAYS_INLINE static void MarkFree(MpPage *page, size_t now) {
+    if (IsPurgeable(page->page_size_)) {
+      MpPageFreeInfo *info = GetFreeInfo(page);
+      info->free_time_ms_ = now;
+      info->purged_ = 0;
+    }
+  }
+
+  /** Purge if a decay period has passed since the last purge */
+  void CheckPurge(size_t now);
+
+  /**
+   * Round a number up to the nearest page size, and store its size class
+   * in \a exp. Arbitrary page sizes are a multiple of sizeof(MpPage), so
+   * page headers stay aligned.
+   * */
   HSHM_ALWAYS_INLINE size_t RoundUp(size_t num, size_t &exp) {
-    size_t round;
-    for (exp = 0; exp < num_caches_; ++exp) {
-      round = 1 << (exp + min_cached_size_exp_);
-      round += sizeof(MpPage);
-      if (num <= round) {
-        return round;
-      }
+    if (num <= max_cached_size_) {
+      exp = PageSizeClasses::GetClass(num - sizeof(MpPage));
+      return PageSizeClasses::GetSize(exp) + sizeof(MpPage);
     }
-    return num;
+    exp = num_caches_;
+    return MemoryAlignment::AlignTo(sizeof(MpPage), num);
   }
 };
 
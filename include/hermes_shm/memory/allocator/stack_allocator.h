@@ -91,15 +91,37 @@ class StackAllocator : public Allocator {
     OffsetPointer p, size_t new_size) override;
 
   /**
-   * Free \a ptr pointer. Null check is performed elsewhere.
+   * Free \a ptr pointer. Null check is performed elsewhere. Stack pages
+   * are never re-used, so their memory is returned to the OS immediately.
    * */
   void FreeOffsetNoNullCheck(OffsetPointer p) override;
 
+  /**
+   * Allocate \a count pages of \a size size, stored in \a out. The pages
+   * are carved with a single bump of the heap.
+   * */
+  void AllocateBatch(size_t size, size_t count, OffsetPointer *out) override;
+
+  /**
+   * Free the \a count pages in \a ptrs.
+   * */
+  void FreeBatch(size_t count, OffsetPointer *ptrs) override;
+
   /**
    * Get the current amount of data allocated. Can be used for leak
    * checking.
    * */
   size_t GetCurrentlyAllocatedSize() override;
+
+  /**
+   * Get the number of bytes of the stack which are resident in RAM.
+   * */
+  size_t GetResidentSize() override;
+
+  /**
+   * Get the number of bytes usable at \a p.
+   * */
+  size_t GetUsableSize(OffsetPointer p) override;
 };
 
 }  // namespace hshm::ipc
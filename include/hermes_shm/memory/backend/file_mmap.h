@@ -0,0 +1,159 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef HERMES_INCLUDE_MEMORY_BACKEND_FILE_MMAP_H
+#define HERMES_INCLUDE_MEMORY_BACKEND_FILE_MMAP_H
+
+#include "memory_backend.h"
+#include "hermes_shm/util/logging.h"
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <hermes_shm/util/errors.h>
+#include <hermes_shm/constants/macros.h>
+#include <hermes_shm/introspect/system_info.h>
+
+namespace hshm::ipc {
+
+/**
+ * Memory backed by a regular file, where the url is the path to the file.
+ * The file outlives the processes which map it, so data structures built
+ * in it can be re-attached after a restart instead of being rebuilt.
+ *
+ * The backend is only detached when destroyed by the registry. The file
+ * is removed by shm_destroy. Checkpoint flushes modified pages to the
+ * file. Allocators with per-thread caches should flush them first, since
+ * cached pages are not recorded in shared memory.
+ * */
+class FileMmap : public MemoryBackend {
+ private:
+  std::string url_;
+  int fd_;
+
+ public:
+  /** Constructor */
+  FileMmap() : fd_(-1) {}
+
+  /** Destructor */
+  ~FileMmap() override {
+    _Detach();
+  }
+
+  /** Initialize backend */
+  bool shm_init(size_t size, std::string url) {
+    SetInitialized();
+    Own();
+    url_ = std::move(url);
+    fd_ = open(url_.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0666);
+    if (fd_ < 0) {
+      HILOG(kError, "open failed: {}", strerror(errno));
+      UnsetInitialized();
+      return false;
+    }
+    _Reserve(size + HERMES_SYSTEM_INFO->page_size_);
+    header_ = _Map<MemoryBackendHeader>(HERMES_SYSTEM_INFO->page_size_, 0);
+    header_->data_size_ = size;
+    data_size_ = size;
+    data_ = _Map(size, HERMES_SYSTEM_INFO->page_size_);
+    return true;
+  }
+
+  /** Deserialize the backend */
+  bool shm_deserialize(std::string url) override {
+    SetInitialized();
+    Disown();
+    url_ = std::move(url);
+    fd_ = open(url_.c_str(), O_RDWR, 0666);
+    if (fd_ < 0) {
+      HILOG(kError, "open failed: {}", strerror(errno));
+      UnsetInitialized();
+      return false;
+    }
+    header_ = _Map<MemoryBackendHeader>(HERMES_SYSTEM_INFO->page_size_, 0);
+    data_size_ = header_->data_size_;
+    data_ = _Map(data_size_, HERMES_SYSTEM_INFO->page_size_);
+    return true;
+  }
+
+  /** Detach the mapped memory */
+  void shm_detach() override {
+    _Detach();
+  }
+
+  /** Destroy the mapped memory and remove the file */
+  void shm_destroy() override {
+    _Destroy();
+  }
+
+  /**
+   * Write modified pages back to the file. If \a sync is true, this waits
+   * until the data is durable. Otherwise, the write-back is only scheduled.
+   * */
+  void Checkpoint(bool sync = true) {
+    if (!IsInitialized()) { return; }
+    int flags = sync ? MS_SYNC : MS_ASYNC;
+    if (msync(data_, data_size_, flags) != 0 ||
+        msync(header_, HERMES_SYSTEM_INFO->page_size_, flags) != 0) {
+      throw SHMEM_SYNC_FAILED.format(strerror(errno));
+    }
+  }
+
+ protected:
+  /** Reserve space in the file */
+  void _Reserve(size_t size) {
+    int ret = ftruncate64(fd_, static_cast<off64_t>(size));
+    if (ret < 0) {
+      throw SHMEM_RESERVE_FAILED.format();
+    }
+  }
+
+  /** Map the file */
+  template<typename T = char>
+  T* _Map(size_t size, off64_t off) {
+    T *ptr = reinterpret_cast<T*>(
+      mmap64(nullptr, size, PROT_READ | PROT_WRITE,
+             MAP_SHARED, fd_, off));
+    if (ptr == MAP_FAILED) {
+      throw SHMEM_CREATE_FAILED.format();
+    }
+    return ptr;
+  }
+
+  /** Unmap the file */
+  void _Detach() {
+    if (!IsInitialized()) { return; }
+    munmap(data_, data_size_);
+    munmap(header_, HERMES_SYSTEM_INFO->page_size_);
+    close(fd_);
+    UnsetInitialized();
+  }
+
+  /** Unmap and remove the file */
+  void _Destroy() {
+    if (!IsInitialized()) { return; }
+    _Detach();
+    unlink(url_.c_str());
+    UnsetInitialized();
+  }
+};
+
+}  // namespace hshm::ipc
+
+#endif  // HERMES_INCLUDE_MEMORY_BACKEND_FILE_MMAP_H
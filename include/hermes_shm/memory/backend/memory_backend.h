@@ -31,6 +31,8 @@ enum class MemoryBackendType {
   kNullBackend,
   kArrayBackend,
   kPosixMmap,
+  kPosixShmHugeMmap,
+  kFileMmap,
 };
 
 #define MEMORY_BACKEND_INITIALIZED 0x1
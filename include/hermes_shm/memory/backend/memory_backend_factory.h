@@ -17,6 +17,8 @@
 #include "memory_backend.h"
 #include "posix_mmap.h"
 #include "posix_shm_mmap.h"
+#include "posix_shm_huge_mmap.h"
+#include "file_mmap.h"
 #include "null_backend.h"
 #include "array_backend.h"
 
@@ -35,6 +37,20 @@ class MemoryBackendFactory {
         throw MEMORY_BACKEND_CREATE_FAILED.format();
       }
       return backend;
+    } else if constexpr(std::is_same_v<PosixShmHugeMmap, BackendT>) {
+      // PosixShmHugeMmap
+      auto backend = std::make_unique<PosixShmHugeMmap>();
+      if (!backend->shm_init(size, url, std::forward<args>(args)...)) {
+        throw MEMORY_BACKEND_CREATE_FAILED.format();
+      }
+      return backend;
+    } else if constexpr(std::is_same_v<FileMmap, BackendT>) {
+      // FileMmap
+      auto backend = std::make_unique<FileMmap>();
+      if (!backend->shm_init(size, url, std::forward<args>(args)...)) {
+        throw MEMORY_BACKEND_CREATE_FAILED.format();
+      }
+      return backend;
     } else if constexpr(std::is_same_v<PosixMmap, BackendT>) {
       // PosixMmap
       auto backend = std::make_unique<PosixMmap>();
@@ -74,6 +90,24 @@ class MemoryBackendFactory {
         return backend;
       }
 
+      // PosixShmHugeMmap
+      case MemoryBackendType::kPosixShmHugeMmap: {
+        auto backend = std::make_unique<PosixShmHugeMmap>();
+        if (!backend->shm_deserialize(url)) {
+          throw MEMORY_BACKEND_NOT_FOUND.format();
+        }
+        return backend;
+      }
+
+      // FileMmap
+      case MemoryBackendType::kFileMmap: {
+        auto backend = std::make_unique<FileMmap>();
+        if (!backend->shm_deserialize(url)) {
+          throw MEMORY_BACKEND_NOT_FOUND.format();
+        }
+        return backend;
+      }
+
       // PosixMmap
       case MemoryBackendType::kPosixMmap: {
         auto backend = std::make_unique<PosixMmap>();
@@ -0,0 +1,268 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef HERMES_INCLUDE_MEMORY_BACKEND_POSIX_SHM_HUGE_MMAP_H
+#define HERMES_INCLUDE_MEMORY_BACKEND_POSIX_SHM_HUGE_MMAP_H
+
+#include "memory_backend.h"
+#include "hermes_shm/util/logging.h"
+#include <string>
+#include <fstream>
+#include <sstream>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/shm.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <hermes_shm/util/errors.h>
+#include <hermes_shm/constants/macros.h>
+#include <hermes_shm/introspect/system_info.h>
+
+namespace hshm::ipc {
+
+/**
+ * Shared memory backed by huge pages. The backend is placed in a
+ * hugetlbfs mount if one exists and has enough free huge pages.
+ * Otherwise, it falls back to a POSIX shared memory object which is
+ * mapped at a huge page boundary and advised to use transparent huge
+ * pages. If neither is available, regular pages are used.
+ *
+ * The header occupies the first huge page and the data starts at the
+ * second, so both are aligned to huge pages.
+ * */
+class PosixShmHugeMmap : public MemoryBackend {
+ private:
+  std::string url_;
+  std::string hugetlbfs_path_;
+  int fd_;
+  bool hugetlb_;
+
+ public:
+  /** The size of a huge page */
+  static const size_t huge_page_size_ = MEGABYTES(2);
+
+ public:
+  /** Constructor */
+  PosixShmHugeMmap() : fd_(-1), hugetlb_(false) {}
+
+  /** Destructor */
+  ~PosixShmHugeMmap() override {
+    if (IsOwned()) {
+      _Destroy();
+    } else {
+      _Detach();
+    }
+  }
+
+  /** Initialize backend */
+  bool shm_init(size_t size, std::string url) {
+    SetInitialized();
+    Own();
+    url_ = std::move(url);
+    size = MemoryAlignment::AlignTo(huge_page_size_, size);
+    // Try hugetlbfs first
+    if (_OpenHugetlbfs(O_CREAT | O_RDWR) &&
+        _Reserve(size + huge_page_size_) &&
+        _MapAll(size)) {
+      header_->data_size_ = size;
+      return true;
+    }
+    _CloseHugetlbfs(true);
+    // Fall back to shm with transparent huge pages
+    shm_unlink(url_.c_str());
+    fd_ = shm_open(url_.c_str(), O_CREAT | O_RDWR, 0666);
+    if (fd_ < 0) {
+      HILOG(kError, "shm_open failed: {}", strerror(errno));
+      return false;
+    }
+    if (!_Reserve(size + huge_page_size_)) {
+      throw SHMEM_RESERVE_FAILED.format();
+    }
+    if (!_MapAll(size)) {
+      throw SHMEM_CREATE_FAILED.format();
+    }
+    header_->data_size_ = size;
+    return true;
+  }
+
+  /** Deserialize the backend */
+  bool shm_deserialize(std::string url) override {
+    SetInitialized();
+    Disown();
+    url_ = std::move(url);
+    if (!_OpenHugetlbfs(O_RDWR)) {
+      fd_ = shm_open(url_.c_str(), O_RDWR, 0666);
+      if (fd_ < 0) {
+        HILOG(kError, "shm_open failed: {}", strerror(errno));
+        return false;
+      }
+    }
+    header_ = _Map<MemoryBackendHeader>(huge_page_size_, 0);
+    if (header_ == nullptr) {
+      throw SHMEM_CREATE_FAILED.format();
+    }
+    data_size_ = header_->data_size_;
+    data_ = _Map(data_size_, huge_page_size_);
+    if (data_ == nullptr) {
+      throw SHMEM_CREATE_FAILED.format();
+    }
+    return true;
+  }
+
+  /** Detach the mapped memory */
+  void shm_detach() override {
+    _Detach();
+  }
+
+  /** Destroy the mapped memory */
+  void shm_destroy() override {
+    _Destroy();
+  }
+
+  /** Whether the backend is placed in hugetlbfs */
+  bool IsHugetlb() {
+    return hugetlb_;
+  }
+
+ protected:
+  /** Find the mount point of hugetlbfs. Empty if not mounted. */
+  static std::string _FindHugetlbfs() {
+    std::ifstream mounts("/proc/mounts");
+    std::string line;
+    while (std::getline(mounts, line)) {
+      std::stringstream ss(line);
+      std::string dev, path, type;
+      ss >> dev >> path >> type;
+      if (type == "hugetlbfs") {
+        return path;
+      }
+    }
+    return "";
+  }
+
+  /** Open the backend's file in hugetlbfs */
+  bool _OpenHugetlbfs(int flags) {
+    std::string mount = _FindHugetlbfs();
+    if (mount.empty()) {
+      return false;
+    }
+    hugetlbfs_path_ = mount + "/" + url_;
+    if (flags & O_CREAT) {
+      unlink(hugetlbfs_path_.c_str());
+    }
+    fd_ = open(hugetlbfs_path_.c_str(), flags, 0666);
+    if (fd_ < 0) {
+      hugetlbfs_path_.clear();
+      return false;
+    }
+    hugetlb_ = true;
+    return true;
+  }
+
+  /** Close and remove the hugetlbfs file after a failed initialization */
+  void _CloseHugetlbfs(bool destroy) {
+    if (!hugetlb_) {
+      return;
+    }
+    if (header_) {
+      munmap(header_, huge_page_size_);
+      header_ = nullptr;
+    }
+    close(fd_);
+    if (destroy) {
+      unlink(hugetlbfs_path_.c_str());
+    }
+    hugetlbfs_path_.clear();
+    hugetlb_ = false;
+  }
+
+  /** Reserve shared memory */
+  bool _Reserve(size_t size) {
+    return ftruncate64(fd_, static_cast<off64_t>(size)) == 0;
+  }
+
+  /** Map the header and \a size bytes of data */
+  bool _MapAll(size_t size) {
+    header_ = _Map<MemoryBackendHeader>(huge_page_size_, 0);
+    if (header_ == nullptr) {
+      return false;
+    }
+    data_size_ = size;
+    data_ = _Map(size, huge_page_size_);
+    return data_ != nullptr;
+  }
+
+  /**
+   * Map shared memory at a huge page boundary. Huge pages are only used
+   * for aligned ranges, which mmap does not guarantee for regular files.
+   * */
+  template<typename T = char>
+  T* _Map(size_t size, off64_t off) {
+    // Reserve enough address space to align the mapping
+    char *region = reinterpret_cast<char*>(
+      mmap64(nullptr, size + huge_page_size_, PROT_NONE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+    if (region == MAP_FAILED) {
+      return nullptr;
+    }
+    char *aligned = reinterpret_cast<char*>(MemoryAlignment::AlignTo(
+      huge_page_size_, reinterpret_cast<size_t>(region)));
+    char *ptr = reinterpret_cast<char*>(
+      mmap64(aligned, size, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED, fd_, off));
+    // Release the unused address space around the mapping
+    if (aligned > region) {
+      munmap(region, aligned - region);
+    }
+    munmap(aligned + size, region + huge_page_size_ - aligned);
+    if (ptr == MAP_FAILED) {
+      munmap(aligned, size);
+      return nullptr;
+    }
+    if (!hugetlb_) {
+      // Not all kernels enable huge pages for shmem, so this can fail
+      madvise(ptr, size, MADV_HUGEPAGE);
+    }
+    return reinterpret_cast<T*>(ptr);
+  }
+
+  /** Unmap shared memory */
+  void _Detach() {
+    if (!IsInitialized()) { return; }
+    munmap(data_, data_size_);
+    munmap(header_, huge_page_size_);
+    close(fd_);
+    UnsetInitialized();
+  }
+
+  /** Destroy shared memory */
+  void _Destroy() {
+    if (!IsInitialized()) { return; }
+    _Detach();
+    if (hugetlb_) {
+      unlink(hugetlbfs_path_.c_str());
+    } else {
+      shm_unlink(url_.c_str());
+    }
+    UnsetInitialized();
+  }
+};
+
+}  // namespace hshm::ipc
+
+#endif  // HERMES_INCLUDE_MEMORY_BACKEND_POSIX_SHM_HUGE_MMAP_H
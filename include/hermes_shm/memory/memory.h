@@ -442,11 +442,10 @@ class MemoryAlignment {
    * */
   HSHM_ALWAYS_INLINE static size_t AlignTo(size_t alignment,
                                            size_t size) {
-    auto page_size = HERMES_SYSTEM_INFO->page_size_;
     size_t new_size = size;
     size_t page_off = size % alignment;
     if (page_off) {
-      new_size = size + page_size - page_off;
+      new_size = size + alignment - page_off;
     }
     return new_size;
   }
@@ -83,6 +83,7 @@ class MemoryManager {
   void DestroyBackend(const std::string &url) {
     auto backend = GetBackend(url);
     backend->Own();
+    backend->shm_destroy();
     UnregisterBackend(url);
   }
 
@@ -194,13 +195,19 @@ class MemoryManager {
    * */
   template<typename T, typename POINTER_T = Pointer>
   HSHM_ALWAYS_INLINE POINTER_T Convert(T *ptr) {
-    for (auto &alloc : HERMES_MEMORY_REGISTRY_REF.allocators_) {
-      if (alloc && alloc->ContainsPtr(ptr)) {
-        return alloc->template
-          Convert<T, POINTER_T>(ptr);
-      }
+    Allocator *alloc = FindAllocator(ptr);
+    if (alloc == nullptr) {
+      return POINTER_T::GetNull();
     }
-    return Pointer::GetNull();
+    return alloc->template Convert<T, POINTER_T>(ptr);
+  }
+
+  /**
+   * Locates the allocator containing a process-specific pointer.
+   * Returns nullptr if no registered allocator contains it.
+   * */
+  HSHM_ALWAYS_INLINE Allocator* FindAllocator(const void *ptr) {
+    return HERMES_MEMORY_REGISTRY_REF.FindAllocator(ptr);
   }
 };
 
@@ -19,6 +19,8 @@
 #include "hermes_shm/memory/backend/posix_mmap.h"
 #include "hermes_shm/util/errors.h"
 #include "hermes_shm/util/logging.h"
+#include <algorithm>
+#include <vector>
 
 namespace hipc = hshm::ipc;
 
@@ -26,6 +28,14 @@ namespace hshm::ipc {
 
 #define MAX_ALLOCATORS 64
 
+/** The range of addresses managed by a registered allocator */
+struct AllocatorRange {
+  size_t start_;          /**< First address of the allocator's buffer */
+  size_t end_;            /**< One past the last address of the buffer */
+  allocator_id_t id_;     /**< The allocator's id */
+  Allocator *alloc_;      /**< The allocator */
+};
+
 class MemoryRegistry {
  public:
   allocator_id_t root_allocator_id_;
@@ -34,6 +44,8 @@ class MemoryRegistry {
   std::unordered_map<std::string, std::unique_ptr<MemoryBackend>> backends_;
   std::unique_ptr<Allocator> allocators_made_[MAX_ALLOCATORS];
   Allocator *allocators_[MAX_ALLOCATORS];
+  std::vector<AllocatorRange> ranges_;  /**< Sorted by start address */
+  AllocatorRange unbounded_;  /**< An allocator without a buffer */
   Allocator *default_allocator_;
 
  public:
@@ -102,6 +114,7 @@ class MemoryRegistry {
       throw std::runtime_error("Too many allocators");
     }
     allocators_[idx] = alloc;
+    RegisterRange(alloc);
   }
 
   /** Unregisters an allocator */
@@ -109,10 +122,37 @@ class MemoryRegistry {
     if (alloc_id == default_allocator_->GetId()) {
       default_allocator_ = &root_allocator_;
     }
+    UnregisterRange(alloc_id);
     allocators_made_[alloc_id.ToIndex()] = nullptr;
     allocators_[alloc_id.ToIndex()] = nullptr;
   }
 
+  /**
+   * Locates the allocator whose buffer contains \a ptr. This is a binary
+   * search over the sorted address ranges of the registered allocators.
+   * The search is branchless, since the pointers being freed are usually
+   * too random for the branch predictor.
+   *
+   * @return the allocator, or nullptr if no allocator contains \a ptr
+   * */
+  HSHM_ALWAYS_INLINE Allocator* FindAllocator(const void *ptr) {
+    size_t addr = reinterpret_cast<size_t>(ptr);
+    size_t count = ranges_.size();
+    if (count == 0) {
+      return unbounded_.alloc_;
+    }
+    const AllocatorRange *range = ranges_.data();
+    while (count > 1) {
+      size_t half = count / 2;
+      range = (range[half].start_ <= addr) ? range + half : range;
+      count -= half;
+    }
+    if (addr < range->start_ || addr >= range->end_) {
+      return unbounded_.alloc_;
+    }
+    return range->alloc_;
+  }
+
   /**
    * Locates an allocator of a particular id
    * */
@@ -142,6 +182,60 @@ class MemoryRegistry {
   HSHM_ALWAYS_INLINE void SetDefaultAllocator(Allocator *alloc) {
     default_allocator_ = alloc;
   }
+
+ private:
+  /**
+   * Insert the address range of \a alloc into the index. Allocators
+   * nested inside another (e.g., the stack of a page allocator) are not
+   * indexed, so pointers resolve to the outermost allocator. Ranges which
+   * overlap the new one are stale and are removed. Allocators without a
+   * buffer are found only when no range contains a pointer.
+   * */
+  void RegisterRange(Allocator *alloc) {
+    AllocatorRange range;
+    range.start_ = reinterpret_cast<size_t>(alloc->GetBuffer());
+    range.end_ = range.start_ + alloc->GetBufferSize();
+    range.id_ = alloc->GetId();
+    range.alloc_ = alloc;
+    UnregisterRange(range.id_);
+    if (alloc->GetBuffer() == nullptr) {
+      unbounded_ = range;
+      return;
+    }
+    for (AllocatorRange &other : ranges_) {
+      bool nested = other.start_ <= range.start_ && range.end_ <= other.end_;
+      bool same = other.start_ == range.start_ && other.end_ == range.end_;
+      if (nested && !same) {
+        return;
+      }
+    }
+    ranges_.erase(std::remove_if(
+      ranges_.begin(), ranges_.end(),
+      [&range](const AllocatorRange &other) {
+        return other.start_ < range.end_ && range.start_ < other.end_;
+      }), ranges_.end());
+    auto iter = std::lower_bound(
+      ranges_.begin(), ranges_.end(), range.start_,
+      [](const AllocatorRange &other, size_t addr) {
+        return other.start_ < addr;
+      });
+    ranges_.insert(iter, range);
+  }
+
+  /** Remove the address range of the allocator \a alloc_id */
+  void UnregisterRange(allocator_id_t alloc_id) {
+    if (unbounded_.alloc_ && unbounded_.id_ == alloc_id) {
+      unbounded_.alloc_ = nullptr;
+    }
+    auto iter = std::find_if(
+      ranges_.begin(), ranges_.end(),
+      [alloc_id](const AllocatorRange &range) {
+        return range.id_ == alloc_id;
+      });
+    if (iter != ranges_.end()) {
+      ranges_.erase(iter);
+    }
+  }
 };
 
 }  // namespace hshm::ipc
@@ -48,6 +48,7 @@ namespace hshm {
   const Error SHMEM_CREATE_FAILED("Failed to allocate SHMEM");
   const Error SHMEM_RESERVE_FAILED("Failed to reserve SHMEM");
   const Error SHMEM_NOT_SUPPORTED("Attempting to deserialize a non-shm backend");
+  const Error SHMEM_SYNC_FAILED("Failed to sync SHMEM: {}");
   const Error MEMORY_BACKEND_CREATE_FAILED("Failed to load memory backend");
   const Error MEMORY_BACKEND_NOT_FOUND("Failed to find the memory backend");
   const Error NOT_ENOUGH_CONCURRENT_SPACE("{}: Failed to divide memory slot {} among {} devices");
@@ -57,6 +58,7 @@ namespace hshm {
   const Error OUT_OF_CACHE("{}: could not cache a page. Allocator overloaded.");
   const Error INVALID_FREE("{}: could not free memory of size {}");
   const Error DOUBLE_FREE("Freeing the same memory twice!");
+  const Error ALLOCATOR_VERSION_MISMATCH("Allocator has layout version {}, but expected {}");
 
   const Error IPC_ARGS_NOT_SHM_COMPATIBLE("Args are not compatible with SHM");
 
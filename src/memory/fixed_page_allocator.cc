@@ -0,0 +1,133 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Distributed under BSD 3-Clause license.                                   *
+ * Copyright by The HDF Group.                                               *
+ * Copyright by the Illinois Institute of Technology.                        *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of Hermes. The full Hermes copyright notice, including  *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the top directory. If you do not  *
+ * have access to the file, you may request a copy from help@hdfgroup.org.   *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include <hermes_shm/memory/allocator/fixed_page_allocator.h>
+#include <algorithm>
+
+namespace hshm::ipc {
+
+/** The bits of the free list head which store the page index */
+#define FIXED_PAGE_IDX_MASK 0xFFFFFFFFull
+/** The amount to increment the free list tag by on each pop */
+#define FIXED_PAGE_TAG_INC (1ull << 32)
+
+void FixedPageAllocator::shm_init(allocator_id_t id,
+                                  size_t custom_header_size,
+                                  char *buffer,
+                                  size_t buffer_size,
+                                  size_t page_size) {
+  buffer_ = buffer;
+  buffer_size_ = buffer_size;
+  header_ = reinterpret_cast<FixedPageAllocatorHeader*>(buffer_);
+  custom_header_ = reinterpret_cast<char*>(header_ + 1);
+  // Free pages must be able to store the link to the next free page
+  page_size_ = MemoryAlignment::AlignTo(sizeof(FixedFreePage), page_size);
+  // Pages are naturally aligned to the largest power of two dividing
+  // their size, up to a system page
+  size_t page_align = page_size_ & (~page_size_ + 1);
+  page_align = std::min<size_t>(page_align, KILOBYTES(4));
+  size_t region_start = reinterpret_cast<size_t>(custom_header_) +
+    custom_header_size;
+  size_t region_off = MemoryAlignment::AlignTo(page_align, region_start) -
+    reinterpret_cast<size_t>(buffer_);
+  size_t region_size = buffer_size_ - region_off;
+  region_size -= region_size % page_size_;
+  if (region_size / page_size_ >= FIXED_PAGE_IDX_MASK) {
+    region_size = (FIXED_PAGE_IDX_MASK - 1) * page_size_;
+  }
+  region_off_ = region_off;
+  header_->Configure(id, custom_header_size, region_off, region_size,
+                     page_size_, page_align);
+}
+
+void FixedPageAllocator::shm_deserialize(char *buffer,
+                                         size_t buffer_size) {
+  buffer_ = buffer;
+  buffer_size_ = buffer_size;
+  header_ = reinterpret_cast<FixedPageAllocatorHeader*>(buffer_);
+  custom_header_ = reinterpret_cast<char*>(header_ + 1);
+  page_size_ = header_->page_size_;
+  region_off_ = header_->region_off_;
+}
+
+size_t FixedPageAllocator::GetCurrentlyAllocatedSize() {
+  return header_->total_alloc_;
+}
+
+size_t FixedPageAllocator::GetUsableSize(OffsetPointer p) {
+  (void) p;
+  return page_size_;
+}
+
+OffsetPointer FixedPageAllocator::PopFreePage() {
+  uint64_t head = header_->free_head_.load(std::memory_order_acquire);
+  while (head & FIXED_PAGE_IDX_MASK) {
+    // The tag changes on every pop, so a stale next_ fails the CAS
+    uint64_t idx = (head & FIXED_PAGE_IDX_MASK) - 1;
+    uint64_t next = GetFreePage(idx)->next_;
+    uint64_t new_head = ((head & ~FIXED_PAGE_IDX_MASK) + FIXED_PAGE_TAG_INC) |
+      (next & FIXED_PAGE_IDX_MASK);
+    if (header_->free_head_.compare_exchange_weak(
+        head, new_head, std::memory_order_acq_rel)) {
+      return OffsetPointer(region_off_ + idx * page_size_);
+    }
+  }
+  return OffsetPointer::GetNull();
+}
+
+void FixedPageAllocator::PushFreePage(OffsetPointer p) {
+  uint64_t idx = (p.load() - region_off_) / page_size_;
+  auto page = GetFreePage(idx);
+  uint64_t head = header_->free_head_.load(std::memory_order_relaxed);
+  uint64_t new_head;
+  do {
+    page->next_ = head & FIXED_PAGE_IDX_MASK;
+    new_head = (head & ~FIXED_PAGE_IDX_MASK) | (idx + 1);
+  } while (!header_->free_head_.compare_exchange_weak(
+      head, new_head, std::memory_order_release));
+}
+
+OffsetPointer FixedPageAllocator::AllocateOffset(size_t size) {
+  if (size > page_size_) {
+    throw PAGE_SIZE_UNSUPPORTED.format(size);
+  }
+  OffsetPointer p = PopFreePage();
+  if (p.IsNull()) {
+    p = header_->heap_.AllocateOffset(page_size_);
+  }
+  header_->total_alloc_.fetch_add(page_size_);
+  return p;
+}
+
+OffsetPointer FixedPageAllocator::AlignedAllocateOffset(size_t size,
+                                                        size_t alignment) {
+  if (alignment > header_->page_align_) {
+    throw ALIGNED_ALLOC_NOT_SUPPORTED.format();
+  }
+  return AllocateOffset(size);
+}
+
+OffsetPointer FixedPageAllocator::ReallocateOffsetNoNullCheck(
+    OffsetPointer p, size_t new_size) {
+  if (new_size > page_size_) {
+    throw PAGE_SIZE_UNSUPPORTED.format(new_size);
+  }
+  return p;
+}
+
+void FixedPageAllocator::FreeOffsetNoNullCheck(OffsetPointer p) {
+  PushFreePage(p);
+  header_->total_alloc_.fetch_sub(page_size_);
+}
+
+}  // namespace hshm::ipc
@@ -17,6 +17,8 @@ namespace hshm::ipc {
 
 struct MallocPage {
   size_t page_size_;
+  /** Offset from the start of the malloc'd block to this header */
+  size_t off_;
 };
 
 void MallocAllocator::shm_init(allocator_id_t id,
@@ -39,19 +41,33 @@ size_t MallocAllocator::GetCurrentlyAllocatedSize() {
   return header_->total_alloc_size_;
 }
 
+size_t MallocAllocator::GetUsableSize(OffsetPointer p) {
+  auto page = reinterpret_cast<MallocPage*>(
+    p.off_.load() - sizeof(MallocPage));
+  return page->page_size_;
+}
+
 OffsetPointer MallocAllocator::AllocateOffset(size_t size) {
   auto page = reinterpret_cast<MallocPage*>(
     malloc(sizeof(MallocPage) + size));
   page->page_size_ = size;
+  page->off_ = 0;
   header_->total_alloc_size_ += size;
   return OffsetPointer((size_t)(page + 1));
 }
 
 OffsetPointer MallocAllocator::AlignedAllocateOffset(size_t size,
                                                      size_t alignment) {
-  auto page = reinterpret_cast<MallocPage*>(
-    aligned_alloc(alignment, sizeof(MallocPage) + size));
+  // The header is placed in the alignment padding before the data
+  size_t pad = alignment;
+  while (pad < sizeof(MallocPage)) {
+    pad += alignment;
+  }
+  size_t block_size = MemoryAlignment::AlignTo(alignment, pad + size);
+  char *block = reinterpret_cast<char*>(aligned_alloc(alignment, block_size));
+  auto page = reinterpret_cast<MallocPage*>(block + pad - sizeof(MallocPage));
   page->page_size_ = size;
+  page->off_ = pad - sizeof(MallocPage);
   header_->total_alloc_size_ += size;
   return OffsetPointer(size_t(page + 1));
 }
@@ -64,8 +80,11 @@ OffsetPointer MallocAllocator::ReallocateOffsetNoNullCheck(OffsetPointer p,
   header_->total_alloc_size_ += new_size - page->page_size_;
 
   // Reallocate the input page
-  auto new_page = reinterpret_cast<MallocPage*>(
-    realloc(page, sizeof(MallocPage) + new_size));
+  size_t off = page->off_;
+  char *block = reinterpret_cast<char*>(page) - off;
+  block = reinterpret_cast<char*>(
+    realloc(block, off + sizeof(MallocPage) + new_size));
+  auto new_page = reinterpret_cast<MallocPage*>(block + off);
   new_page->page_size_ = new_size;
 
   // Create the pointer
@@ -76,7 +95,7 @@ void MallocAllocator::FreeOffsetNoNullCheck(OffsetPointer p) {
   auto page = reinterpret_cast<MallocPage*>(
     p.off_.load() - sizeof(MallocPage));
   header_->total_alloc_size_ -= page->page_size_;
-  free(page);
+  free(reinterpret_cast<char*>(page) - page->off_);
 }
 
 }  // namespace hshm::ipc
@@ -12,83 +12,317 @@
 
 #include <malloc.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <new>
+#include "memory_intercept.h"
 #include "hermes_shm/memory/memory_manager.h"
+#include "hermes_shm/thread/thread_model_manager.h"
+#include "hermes_shm/util/config_parse.h"
 
-using hshm::ipc::Pointer;
-using hshm::ipc::Allocator;
+using hshm::ipc::MemoryIntercept;
+
+namespace hshm::ipc {
+
+std::atomic<InterceptState> MemoryIntercept::state_(
+  InterceptState::kUninitialized);
+PosixShmMmap *MemoryIntercept::backend_ = nullptr;
+ScalablePageAllocator *MemoryIntercept::alloc_ = nullptr;
+size_t MemoryIntercept::start_ = 0;
+size_t MemoryIntercept::end_ = 0;
+char MemoryIntercept::url_[256];
+
+/**
+ * Whether the calling thread is inside hermes. Uses the initial-exec
+ * model, since other TLS models may allocate on first access.
+ * */
+static __thread bool busy_ __attribute__((tls_model("initial-exec")));
+
+/** Storage for the backend and allocator, which are never destructed */
+alignas(PosixShmMmap) static char backend_storage_[sizeof(PosixShmMmap)];
+alignas(ScalablePageAllocator)
+static char alloc_storage_[sizeof(ScalablePageAllocator)];
+
+bool MemoryIntercept::Enter() {
+  if (busy_) {
+    return false;
+  }
+  InterceptState state = state_.load(std::memory_order_acquire);
+  if (state != InterceptState::kReady) {
+    if (state != InterceptState::kUninitialized || !Initialize()) {
+      return false;
+    }
+  }
+  busy_ = true;
+  return true;
+}
+
+void MemoryIntercept::Exit() {
+  busy_ = false;
+}
+
+#define TRACE(x) write(2, x "\n", sizeof(x))
+bool MemoryIntercept::Initialize() {
+  TRACE("init");
+  // The heap needs the hermes singletons, which are constructed in an
+  // unspecified order
+  if (HERMES_SYSTEM_INFO == nullptr || HERMES_MEMORY_REGISTRY == nullptr ||
+      HERMES_MEMORY_MANAGER == nullptr || HERMES_THREAD_MODEL == nullptr) {
+    return false;
+  }
+  InterceptState state = InterceptState::kUninitialized;
+  if (!state_.compare_exchange_strong(state,
+                                      InterceptState::kInitializing)) {
+    return false;
+  }
+  busy_ = true;
+  TRACE("init2");
+  try {
+    char *url = getenv("HERMES_INTERCEPT_URL");
+    if (url) {
+      snprintf(url_, sizeof(url_), "%s", url);
+    } else {
+      snprintf(url_, sizeof(url_), "hermes_intercept_%d", getpid());
+    }
+    char *size_text = getenv("HERMES_INTERCEPT_SIZE");
+    size_t size = size_text ? ConfigParse::ParseSize(size_text) :
+      MemoryManager::GetDefaultBackendSize();
+    TRACE("backend");
+    backend_ = new (backend_storage_) PosixShmMmap();
+    if (!backend_->shm_init(size, url_)) {
+      throw SHMEM_CREATE_FAILED.format();
+    }
+    TRACE("alloc");
+    alloc_ = new (alloc_storage_) ScalablePageAllocator();
+    alloc_->shm_init(alloc_id_, 0, backend_->data_, backend_->data_size_);
+    TRACE("register");
+    HERMES_MEMORY_MANAGER->RegisterAllocator(alloc_);
+    TRACE("registered");
+    start_ = reinterpret_cast<size_t>(backend_->data_);
+    end_ = start_ + backend_->data_size_;
+    atexit(Finalize);
+    state_.store(InterceptState::kReady, std::memory_order_release);
+  } catch (...) {
+    HELOG(kError, "Failed to create the intercepted heap: {}", url_);
+    state_.store(InterceptState::kFailed, std::memory_order_release);
+  }
+  busy_ = false;
+  return state_.load() == InterceptState::kReady;
+}
+
+void MemoryIntercept::Finalize() {
+  TRACE("fini");
+  state_.store(InterceptState::kFinalized, std::memory_order_release);
+  shm_unlink(url_);
+}
+
+void* MemoryIntercept::Allocate(size_t size, size_t alignment) {
+  // Pages are already aligned to the page header
+  if (alignment <= sizeof(MpPage)) {
+    alignment = 0;
+  }
+  try {
+    return alloc_->AllocatePtr<void>(size, alignment);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void MemoryIntercept::Free(void *ptr) {
+  // The allocator may rely on singletons which are destroyed at exit, so
+  // the memory is left to the OS
+  if (state_.load(std::memory_order_acquire) == InterceptState::kFinalized) {
+    return;
+  }
+  bool busy = busy_;
+  busy_ = true;
+  alloc_->FreePtr(ptr);
+  busy_ = busy;
+}
+
+size_t MemoryIntercept::GetUsableSize(void *ptr) {
+  return alloc_->GetUsableSize(alloc_->Convert<void, OffsetPointer>(ptr));
+}
+
+}  // namespace hshm::ipc
+
+/** Whether \a alignment is a power of two */
+static bool IsPowerOfTwo(size_t alignment) {
+  return alignment && (alignment & (alignment - 1)) == 0;
+}
+
+/** Allocate SIZE bytes aligned to ALIGNMENT, a power of two. */
+static void* AlignedAllocate(size_t alignment, size_t size) {
+  if (!MemoryIntercept::Enter()) {
+    return __libc_memalign(alignment, size);
+  }
+  void *ptr = MemoryIntercept::Allocate(size, alignment);
+  MemoryIntercept::Exit();
+  if (ptr == nullptr) {
+    return __libc_memalign(alignment, size);
+  }
+  return ptr;
+}
 
 /** Allocate SIZE bytes of memory. */
-void* malloc(size_t size) {
-  auto alloc = HERMES_MEMORY_MANAGER->GetDefaultAllocator();
-  return alloc->AllocatePtr<void>(size);
+void* malloc(size_t size) noexcept {
+  if (!MemoryIntercept::Enter()) {
+    return __libc_malloc(size);
+  }
+  void *ptr = MemoryIntercept::Allocate(size, 0);
+  MemoryIntercept::Exit();
+  if (ptr == nullptr) {
+    return __libc_malloc(size);
+  }
+  return ptr;
 }
 
 /** Allocate NMEMB elements of SIZE bytes each, all initialized to 0. */
-void* calloc(size_t nmemb, size_t size) {
-  auto alloc = HERMES_MEMORY_MANAGER->GetDefaultAllocator();
-  return alloc->ClearAllocatePtr<void>(nmemb * size);
+void* calloc(size_t nmemb, size_t size) noexcept {
+  size_t total;
+  if (__builtin_mul_overflow(nmemb, size, &total)) {
+    errno = ENOMEM;
+    return nullptr;
+  }
+  if (!MemoryIntercept::Enter()) {
+    return __libc_calloc(nmemb, size);
+  }
+  void *ptr = MemoryIntercept::Allocate(total, 0);
+  MemoryIntercept::Exit();
+  if (ptr == nullptr) {
+    return __libc_calloc(nmemb, size);
+  }
+  memset(ptr, 0, total);
+  return ptr;
 }
 
 /**
  * Re-allocate the previously allocated block in ptr, making the new
  * block SIZE bytes long.
  * */
-void* realloc(void *ptr, size_t size) {
-  Pointer p = HERMES_MEMORY_MANAGER->Convert(ptr);
-  auto alloc = HERMES_MEMORY_MANAGER->GetAllocator(p.allocator_id_);
-  return alloc->AllocatePtr<void>(size);
+void* realloc(void *ptr, size_t size) noexcept {
+  if (ptr == nullptr) {
+    return malloc(size);
+  }
+  if (!MemoryIntercept::Contains(ptr)) {
+    return __libc_realloc(ptr, size);
+  }
+  if (size == 0) {
+    free(ptr);
+    return nullptr;
+  }
+  // Pages are rounded to their size class, so they often have room
+  size_t old_size = MemoryIntercept::GetUsableSize(ptr);
+  if (size <= old_size) {
+    return ptr;
+  }
+  void *new_ptr = malloc(size);
+  if (new_ptr == nullptr) {
+    return nullptr;
+  }
+  memcpy(new_ptr, ptr, old_size);
+  free(ptr);
+  return new_ptr;
 }
 
 /**
  * Re-allocate the previously allocated block in PTR, making the new
  * block large enough for NMEMB elements of SIZE bytes each.
  * */
-void* reallocarray(void *ptr, size_t nmemb, size_t size) {
-  return realloc(ptr, nmemb * size);
+void* reallocarray(void *ptr, size_t nmemb, size_t size) noexcept {
+  size_t total;
+  if (__builtin_mul_overflow(nmemb, size, &total)) {
+    errno = ENOMEM;
+    return nullptr;
+  }
+  return realloc(ptr, total);
 }
 
 /** Free a block allocated by `malloc', `realloc' or `calloc'. */
-void free(void *ptr) {
-  Pointer p = HERMES_MEMORY_MANAGER->Convert(ptr);
-  auto alloc = HERMES_MEMORY_MANAGER->GetAllocator(p.allocator_id_);
-  alloc->Free(p);
+void free(void *ptr) noexcept {
+  if (ptr == nullptr) {
+    return;
+  }
+  if (!MemoryIntercept::Contains(ptr)) {
+    __libc_free(ptr);
+    return;
+  }
+  MemoryIntercept::Free(ptr);
 }
 
 /** Allocate SIZE bytes allocated to ALIGNMENT bytes. */
-void* memalign(size_t alignment, size_t size) {
-  // TODO(llogan): need to add an aligned allocator
-  return malloc(size);
+void* memalign(size_t alignment, size_t size) noexcept {
+  // Like glibc, round the alignment up to a power of two
+  if (!IsPowerOfTwo(alignment)) {
+    if (alignment > (SIZE_MAX >> 1) + 1) {
+      errno = EINVAL;
+      return nullptr;
+    }
+    alignment = size_t(1) << (64 - __builtin_clzll(alignment));
+  }
+  return AlignedAllocate(alignment, size);
 }
 
 /** Allocate SIZE bytes on a page boundary. */
-void* valloc(size_t size) {
-  return memalign(HERMES_SYSTEM_INFO->page_size_, size);
+void* valloc(size_t size) noexcept {
+  return AlignedAllocate(getpagesize(), size);
 }
 
 /**
  * Equivalent to valloc(minimum-page-that-holds(n)),
  * that is, round up size to nearest pagesize.
  * */
-void* pvalloc(size_t size) {
-  size_t new_size = hipc::MemoryAlignment::AlignToPageSize(size);
-  return valloc(new_size);
+void* pvalloc(size_t size) noexcept {
+  size_t page_size = getpagesize();
+  if (size > SIZE_MAX - page_size) {
+    errno = ENOMEM;
+    return nullptr;
+  }
+  size_t new_size = hipc::MemoryAlignment::AlignTo(page_size, size);
+  return AlignedAllocate(page_size, new_size);
 }
 
 /**
  * Allocates size bytes and places the address of the
  * allocated memory in *memptr. The address of the allocated memory
  * will be a multiple of alignment, which must be a power of two and a multiple
- * of sizeof(void*). Returns NULL if size is 0. */
-int posix_memalign(void **memptr, size_t alignment, size_t size) {
-  (*memptr) = memalign(alignment, size);
+ * of sizeof(void*). */
+int posix_memalign(void **memptr, size_t alignment, size_t size) noexcept {
+  if (!IsPowerOfTwo(alignment) || alignment % sizeof(void*) != 0) {
+    return EINVAL;
+  }
+  void *ptr = AlignedAllocate(alignment, size);
+  if (ptr == nullptr) {
+    return ENOMEM;
+  }
+  (*memptr) = ptr;
   return 0;
 }
 
-/**
- * Aligned to an alignment with a size that is a multiple of the
- * alignment
- * */
-void *aligned_alloc(size_t alignment, size_t size) {
-  return memalign(alignment,
-                  hshm::ipc::NextAlignmentMultiple(alignment, size));
+/** Allocate SIZE bytes aligned to ALIGNMENT, a power of two. */
+void *aligned_alloc(size_t alignment, size_t size) noexcept {
+  if (!IsPowerOfTwo(alignment)) {
+    errno = EINVAL;
+    return nullptr;
+  }
+  return AlignedAllocate(alignment, size);
+}
+
+/** Get the number of bytes usable in the block at PTR. */
+size_t malloc_usable_size(void *ptr) noexcept {
+  typedef size_t (*usable_size_t)(void*);
+  static usable_size_t libc_usable_size = nullptr;
+  if (ptr == nullptr) {
+    return 0;
+  }
+  if (MemoryIntercept::Contains(ptr)) {
+    return MemoryIntercept::GetUsableSize(ptr);
+  }
+  if (libc_usable_size == nullptr) {
+    libc_usable_size = reinterpret_cast<usable_size_t>(
+      dlsym(RTLD_NEXT, "malloc_usable_size"));
+  }
+  return libc_usable_size(ptr);
 }
@@ -13,4 +13,96 @@
 #ifndef HERMES_SRC_MEMORY_MEMORY_INTERCEPT_H_
 #define HERMES_SRC_MEMORY_MEMORY_INTERCEPT_H_
 
+#include <stddef.h>
+#include <atomic>
+#include "hermes_shm/memory/allocator/scalable_page_allocator.h"
+#include "hermes_shm/memory/backend/posix_shm_mmap.h"
+
+/**
+ * The glibc allocator. Used for allocations made before the shared heap
+ * exists and for those made by hermes itself while intercepting a call.
+ * */
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t nmemb, size_t size);
+void* __libc_realloc(void *ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *ptr);
+}
+
+namespace hshm::ipc {
+
+/** The stages of the intercepted heap */
+enum class InterceptState {
+  kUninitialized,  /**< The hermes singletons are not yet constructed */
+  kInitializing,   /**< A thread is creating the shared heap */
+  kReady,          /**< Allocations are placed in the shared heap */
+  kFinalized,      /**< The process is exiting */
+  kFailed,         /**< The shared heap could not be created */
+};
+
+/**
+ * Places the heap of a program in shared memory when this library is
+ * preloaded. The heap is a ScalablePageAllocator over a PosixShmMmap
+ * backend, which is created on the first allocation after the hermes
+ * singletons are constructed. The backend's url and size are taken from
+ * the HERMES_INTERCEPT_URL and HERMES_INTERCEPT_SIZE environment variables.
+ *
+ * The backend and allocator are never destructed, since the program may
+ * free memory after static destructors run. The shared memory is unlinked
+ * at exit.
+ * */
+class MemoryIntercept {
+ public:
+  /** The id of the intercepted heap's allocator */
+  static inline const allocator_id_t alloc_id_{15, 0};
+
+ private:
+  static std::atomic<InterceptState> state_;
+  static PosixShmMmap *backend_;
+  static ScalablePageAllocator *alloc_;
+  static size_t start_;
+  static size_t end_;
+  static char url_[256];
+
+ public:
+  /**
+   * Begin an allocation in the shared heap. Returns false if the call
+   * should go to glibc instead: before the heap exists, or when hermes
+   * itself allocates from within an intercepted call.
+   * */
+  static bool Enter();
+
+  /** End an allocation begun by Enter */
+  static void Exit();
+
+  /** Whether \a ptr lies in the shared heap */
+  static bool Contains(const void *ptr) {
+    size_t addr = reinterpret_cast<size_t>(ptr);
+    return start_ <= addr && addr < end_;
+  }
+
+  /**
+   * Allocate from the shared heap. Must be called between Enter and Exit.
+   *
+   * @return the allocation, or nullptr if the heap is exhausted
+   * */
+  static void* Allocate(size_t size, size_t alignment);
+
+  /** Free \a ptr, which must lie in the shared heap */
+  static void Free(void *ptr);
+
+  /** Get the number of bytes usable at \a ptr in the shared heap */
+  static size_t GetUsableSize(void *ptr);
+
+ private:
+  /** Create the shared heap. Returns true if it is ready. */
+  static bool Initialize();
+
+  /** Stop using the shared heap and unlink it. Runs at exit. */
+  static void Finalize();
+};
+
+}  // namespace hshm::ipc
+
 #endif  // HERMES_SRC_MEMORY_MEMORY_INTERCEPT_H_
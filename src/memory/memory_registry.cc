@@ -24,6 +24,7 @@ MemoryRegistry::MemoryRegistry() {
                            root_backend_.data_size_);
   default_allocator_ = &root_allocator_;
   memset(allocators_, 0, sizeof(allocators_));
+  unbounded_.alloc_ = nullptr;
   RegisterAllocator(&root_allocator_);
 }
 
@@ -13,26 +13,71 @@
 
 #include <hermes_shm/memory/allocator/scalable_page_allocator.h>
 #include <hermes_shm/memory/allocator/mp_page.h>
+#include <algorithm>
 
 namespace hshm::ipc {
 
+/** The maximum number of threads which can own a front-end cache slot */
+#define HSHM_MAX_THREAD_CACHE_SLOTS 256
+
+/** Which front-end cache slots are owned by a live thread */
+static std::atomic<bool> thread_cache_slots_[HSHM_MAX_THREAD_CACHE_SLOTS];
+
+/**
+ * A front-end cache slot owned by a thread for its lifetime. A slot is
+ * shared by all ScalablePageAllocators in the process. When the thread
+ * exits, the slot (and any pages cached in it) is inherited by the next
+ * thread which claims it.
+ * */
+struct ThreadCacheSlot {
+  int id_;
+
+  /** Claim the first unowned slot */
+  ThreadCacheSlot() : id_(-1) {
+    for (int i = 0; i < HSHM_MAX_THREAD_CACHE_SLOTS; ++i) {
+      bool owned = false;
+      if (thread_cache_slots_[i].compare_exchange_strong(
+          owned, true, std::memory_order_acquire)) {
+        id_ = i;
+        return;
+      }
+    }
+  }
+
+  /** Release the slot */
+  ~ThreadCacheSlot() {
+    if (id_ >= 0) {
+      thread_cache_slots_[id_].store(false, std::memory_order_release);
+    }
+  }
+};
+
+ScalablePageAllocator::~ScalablePageAllocator() {
+  for (std::atomic<ThreadCache*> &tcache : thread_caches_) {
+    delete tcache.load();
+  }
+}
+
 void ScalablePageAllocator::shm_init(allocator_id_t id,
                                      size_t custom_header_size,
                                      char *buffer,
                                      size_t buffer_size,
                                      RealNumber coalesce_trigger,
-                                     size_t coalesce_window) {
+                                     size_t coalesce_window,
+                                     size_t purge_decay_ms) {
   buffer_ = buffer;
   buffer_size_ = buffer_size;
   header_ = reinterpret_cast<ScalablePageAllocatorHeader*>(buffer_);
   custom_header_ = reinterpret_cast<char*>(header_ + 1);
-  size_t region_off = (custom_header_ - buffer_) + custom_header_size;
+  size_t region_off = MemoryAlignment::AlignTo(
+    sizeof(MpPage), (custom_header_ - buffer_) + custom_header_size);
   size_t region_size = buffer_size_ - region_off;
   allocator_id_t sub_id(id.bits_.major_, id.bits_.minor_ + 1);
   alloc_.shm_init(sub_id, 0, buffer + region_off, region_size);
   HERMES_MEMORY_REGISTRY_REF.RegisterAllocator(&alloc_);
   header_->Configure(id, custom_header_size, &alloc_,
-                     buffer_size, coalesce_trigger, coalesce_window);
+                     buffer_size, coalesce_trigger, coalesce_window,
+                     purge_decay_ms);
   vector<FreeListSetIpc> *free_lists = header_->free_lists_.get();
   size_t ncpu = HERMES_SYSTEM_INFO->ncpu_;
   free_lists->resize(num_free_lists_, ncpu);
@@ -44,8 +89,13 @@ void ScalablePageAllocator::shm_deserialize(char *buffer,
   buffer_ = buffer;
   buffer_size_ = buffer_size;
   header_ = reinterpret_cast<ScalablePageAllocatorHeader*>(buffer_);
+  if (header_->version_ != ScalablePageAllocatorHeader::kVersion) {
+    throw ALLOCATOR_VERSION_MISMATCH.format(
+      header_->version_, ScalablePageAllocatorHeader::kVersion);
+  }
   custom_header_ = reinterpret_cast<char*>(header_ + 1);
-  size_t region_off = (custom_header_ - buffer_) + header_->custom_header_size_;
+  size_t region_off = MemoryAlignment::AlignTo(
+    sizeof(MpPage), (custom_header_ - buffer_) + header_->custom_header_size_);
   size_t region_size = buffer_size_ - region_off;
   alloc_.shm_deserialize(buffer + region_off, region_size);
   HERMES_MEMORY_REGISTRY_REF.RegisterAllocator(&alloc_);
@@ -53,44 +103,401 @@ void ScalablePageAllocator::shm_deserialize(char *buffer,
 }
 
 size_t ScalablePageAllocator::GetCurrentlyAllocatedSize() {
-  return header_->total_alloc_;
+  size_t total_alloc = header_->total_alloc_;
+  OffsetPointer counter_ptr = header_->thread_counters_.ToOffsetPointer();
+  while (!counter_ptr.IsNull()) {
+    auto counter = Convert<ThreadAllocCounter>(counter_ptr);
+    total_alloc += counter->total_alloc_.load(std::memory_order_relaxed);
+    counter_ptr = counter->next_;
+  }
+  return total_alloc;
 }
 
-OffsetPointer ScalablePageAllocator::AllocateOffset(size_t size) {
+size_t ScalablePageAllocator::GetResidentSize() {
+  return alloc_.GetResidentSize();
+}
+
+size_t ScalablePageAllocator::GetUsableSize(OffsetPointer p) {
+  auto hdr = Convert<MpPage>(p - sizeof(MpPage));
+  return hdr->page_size_ - sizeof(MpPage);
+}
+
+size_t ScalablePageAllocator::Purge() {
+  size_t now = PagePurge::GetTimeMs();
+  size_t decay = header_->purge_decay_ms_;
+  size_t released = 0;
+  // Only the lists past the magazine classes hold purgeable pages
+  for (size_t exp = num_magazines_; exp < num_free_lists_; ++exp) {
+    FreeListSet &free_list_set = free_lists_[exp];
+    for (std::pair<Mutex*, iqueue<MpPage>*> &free_list_pair :
+         free_list_set.lists_) {
+      Mutex &lock = *free_list_pair.first;
+      iqueue<MpPage> &free_list = *free_list_pair.second;
+      ScopedMutex scoped_lock(lock, 0);
+      for (auto iter = free_list.begin(); iter != free_list.end(); ++iter) {
+        MpPage *page = *iter;
+        if (!IsPurgeable(page->page_size_)) {
+          continue;
+        }
+        MpPageFreeInfo *info = GetFreeInfo(page);
+        if (info->purged_ || now < info->free_time_ms_ + decay) {
+          continue;
+        }
+        // Keep the page header and free info resident
+        released += PagePurge::Release(
+          reinterpret_cast<char*>(info + 1),
+          page->page_size_ - sizeof(MpPage) - sizeof(MpPageFreeInfo));
+        info->purged_ = 1;
+      }
+    }
+  }
+  return released;
+}
+
+void ScalablePageAllocator::CheckPurge(size_t now) {
+  size_t decay = header_->purge_decay_ms_;
+  if (decay == 0) {
+    return;
+  }
+  size_t last_purge = header_->last_purge_ms_.load();
+  if (now < last_purge + decay) {
+    return;
+  }
+  if (header_->last_purge_ms_.compare_exchange_strong(last_purge, now)) {
+    Purge();
+  }
+}
+
+ThreadAllocCounter* ScalablePageAllocator::RegisterThreadCounter() {
+  // Place the counter on its own cache line
+  OffsetPointer off = alloc_.AllocateOffset(2 * HSHM_CACHE_LINE_SIZE);
+  size_t addr = reinterpret_cast<size_t>(alloc_.Convert<char>(off));
+  addr = (addr + HSHM_CACHE_LINE_SIZE - 1) & ~(HSHM_CACHE_LINE_SIZE - 1);
+  auto counter = reinterpret_cast<ThreadAllocCounter*>(addr);
+  counter->total_alloc_ = 0;
+
+  // Push the counter onto the list of counters
+  size_t counter_off = Convert<ThreadAllocCounter, OffsetPointer>(counter)
+    .load();
+  size_t head = header_->thread_counters_.load();
+  do {
+    counter->next_ = OffsetPointer(head);
+  } while (!header_->thread_counters_.compare_exchange_weak(head,
+                                                            counter_off));
+  return counter;
+}
+
+ScalablePageAllocator::ThreadCache* ScalablePageAllocator::GetThreadCache() {
+  static_assert(max_thread_caches_ == HSHM_MAX_THREAD_CACHE_SLOTS);
+  static_assert(num_magazines_ <= num_caches_);
+  static_assert(PageSizeClasses::GetSize(num_magazines_ - 1) ==
+                KILOBYTES(64));
+  static thread_local ThreadCacheSlot slot;
+  if (slot.id_ < 0) {
+    return nullptr;
+  }
+  std::atomic<ThreadCache*> &tcache_ptr = thread_caches_[slot.id_];
+  ThreadCache *tcache = tcache_ptr.load(std::memory_order_relaxed);
+  if (tcache == nullptr) {
+    tcache = new ThreadCache(RegisterThreadCounter());
+    tcache_ptr.store(tcache, std::memory_order_release);
+  }
+  return tcache;
+}
+
+MpPage* ScalablePageAllocator::AllocateFromMagazine(ThreadCache &tcache,
+                                                    size_t exp) {
+  Magazine &mag = tcache.mags_[exp];
+  if (mag.IsEmpty()) {
+    RefillMagazine(mag, exp);
+    if (mag.IsEmpty()) {
+      return nullptr;
+    }
+  }
+  return mag.pop();
+}
+
+void ScalablePageAllocator::FreeToMagazine(ThreadCache &tcache,
+                                           MpPage *page,
+                                           size_t exp) {
+  Magazine &mag = tcache.mags_[exp];
+  if (mag.IsFull()) {
+    FlushMagazine(mag, exp);
+  }
+  mag.push(page);
+}
+
+void ScalablePageAllocator::RefillMagazine(Magazine &mag, size_t exp) {
+  FreeListSet &free_list_set = free_lists_[exp];
+  uint16_t conc = free_list_set.rr_alloc_->fetch_add(1) %
+    free_list_set.lists_.size();
+  std::pair<Mutex*, iqueue<MpPage>*> free_list_pair =
+    free_list_set.lists_[conc];
+  Mutex &lock = *free_list_pair.first;
+  iqueue<MpPage> &free_list = *free_list_pair.second;
+  ScopedMutex scoped_lock(lock, 0);
+  while (mag.count_ < magazine_batch_ && free_list.size()) {
+    mag.push(free_list.dequeue());
+  }
+}
+
+MpPage* ScalablePageAllocator::CarveMagazine(ThreadCache &tcache,
+                                             size_t size_mp,
+                                             size_t exp) {
+  // Fall back to a single page when the stack is nearly exhausted,
+  // so the batch doesn't waste it.
+  Magazine &mag = tcache.mags_[exp];
+  HeapAllocator &heap = *alloc_.heap_;
+  size_t batch_size = magazine_batch_ * size_mp;
+  size_t num_pages = magazine_batch_;
+  if (heap.heap_off_.load() + 2 * batch_size > heap.heap_size_) {
+    num_pages = 1;
+  }
+  OffsetPointer off = heap.TryAllocateOffset(num_pages * size_mp);
+  if (off.IsNull()) {
+    return nullptr;
+  }
+  char *region = alloc_.Convert<char>(off);
+  for (size_t i = num_pages; i > 0; --i) {
+    auto page = reinterpret_cast<MpPage*>(region + (i - 1) * size_mp);
+    page->page_size_ = size_mp;
+    page->flags_.Clear();
+    page->off_ = 0;
+    mag.push(page);
+  }
+  return mag.pop();
+}
+
+void ScalablePageAllocator::FlushThreadCache() {
+  ThreadCache *tcache = GetThreadCache();
+  if (tcache == nullptr) {
+    return;
+  }
+  for (size_t exp = 0; exp < num_magazines_; ++exp) {
+    Magazine &mag = tcache->mags_[exp];
+    if (mag.IsEmpty()) {
+      continue;
+    }
+    FreeListSet &free_list_set = free_lists_[exp];
+    uint16_t conc = free_list_set.rr_free_->fetch_add(1) %
+      free_list_set.lists_.size();
+    std::pair<Mutex*, iqueue<MpPage>*> free_list_pair =
+      free_list_set.lists_[conc];
+    Mutex &lock = *free_list_pair.first;
+    iqueue<MpPage> &free_list = *free_list_pair.second;
+    ScopedMutex scoped_lock(lock, 0);
+    while (!mag.IsEmpty()) {
+      free_list.enqueue(mag.pop());
+    }
+  }
+}
+
+void ScalablePageAllocator::FlushMagazine(Magazine &mag, size_t exp) {
+  FreeListSet &free_list_set = free_lists_[exp];
+  uint16_t conc = free_list_set.rr_free_->fetch_add(1) %
+    free_list_set.lists_.size();
+  std::pair<Mutex*, iqueue<MpPage>*> free_list_pair =
+    free_list_set.lists_[conc];
+  Mutex &lock = *free_list_pair.first;
+  iqueue<MpPage> &free_list = *free_list_pair.second;
+  ScopedMutex scoped_lock(lock, 0);
+  for (size_t i = 0; i < magazine_batch_; ++i) {
+    free_list.enqueue(mag.pop());
+  }
+}
+
+MpPage* ScalablePageAllocator::AllocateFromStack(size_t size_mp) {
+  OffsetPointer off = alloc_.heap_->TryAllocateOffset(size_mp);
+  if (off.IsNull()) {
+    return nullptr;
+  }
+  auto page = alloc_.Convert<MpPage>(off);
+  page->page_size_ = size_mp;
+  page->flags_.Clear();
+  page->off_ = 0;
+  return page;
+}
+
+MpPage* ScalablePageAllocator::CheckCoalesce(size_t size_mp, bool force) {
+  size_t footprint = GetFootprint();
+  if (!force) {
+    // Only search the arbitrary list when enough space is being wasted
+    size_t total_alloc = alloc_.GetCurrentlyAllocatedSize() +
+      GetCurrentlyAllocatedSize();
+    if (total_alloc >= footprint ||
+        footprint - total_alloc < header_->coalesce_trigger_) {
+      return nullptr;
+    }
+  }
+
+  // Re-use a page merged by a prior coalesce
+  MpPage *page = FindFirstFitAll(size_mp);
+  if (page) {
+    return page;
+  }
+
+  // Coalesce at most once per window of stack growth
+  size_t last_coalesce = header_->last_coalesce_.load();
+  if (!force && footprint < last_coalesce + header_->coalesce_window_) {
+    return nullptr;
+  }
+  FlushThreadCache();
+  Coalesce();
+  header_->last_coalesce_ = GetFootprint();
+  return FindFirstFitAll(size_mp);
+}
+
+void ScalablePageAllocator::Coalesce() {
+  // Lock every lane of every free list (always in the same order)
+  for (FreeListSet &free_list_set : free_lists_) {
+    for (std::pair<Mutex*, iqueue<MpPage>*> &free_list_pair :
+         free_list_set.lists_) {
+      free_list_pair.first->Lock(0);
+    }
+  }
+
+  // Drain the free lists and sort the pages by address
+  std::vector<MpPage*> pages;
+  for (FreeListSet &free_list_set : free_lists_) {
+    for (std::pair<Mutex*, iqueue<MpPage>*> &free_list_pair :
+         free_list_set.lists_) {
+      iqueue<MpPage> &free_list = *free_list_pair.second;
+      while (free_list.size()) {
+        pages.emplace_back(free_list.dequeue());
+      }
+    }
+  }
+  std::sort(pages.begin(), pages.end());
+
+  // Merge pages which are adjacent in memory
+  size_t count = 0;
+  size_t now = PagePurge::GetTimeMs();
+  for (MpPage *page : pages) {
+    if (count > 0) {
+      MpPage *prior = pages[count - 1];
+      if (reinterpret_cast<char*>(prior) + prior->page_size_ ==
+          reinterpret_cast<char*>(page)) {
+        size_t prior_size = prior->page_size_;
+        prior->page_size_ += page->page_size_;
+        if (IsPurgeable(prior_size)) {
+          GetFreeInfo(prior)->purged_ = 0;
+        } else {
+          MarkFree(prior, now);
+        }
+        continue;
+      }
+    }
+    pages[count++] = page;
+  }
+  pages.resize(count);
+
+  // Return the last page to the stack if it is at the top
+  if (count > 0) {
+    MpPage *last = pages.back();
+    OffsetPointer last_off = alloc_.Convert<MpPage, OffsetPointer>(last);
+    if (alloc_.heap_->FreeTail(last_off, last->page_size_)) {
+      pages.pop_back();
+    }
+  }
+
+  // Redistribute the pages to the free lists
+  size_t rr = 0;
+  for (MpPage *page : pages) {
+    page->flags_.Clear();
+    page->off_ = 0;
+    FreeListSet &free_list_set =
+      free_lists_[GetFreeListSetId(page->page_size_)];
+    free_list_set.lists_[rr++ % free_list_set.lists_.size()]
+      .second->enqueue(page);
+  }
+
+  // Unlock the free lists
+  for (FreeListSet &free_list_set : free_lists_) {
+    for (std::pair<Mutex*, iqueue<MpPage>*> &free_list_pair :
+         free_list_set.lists_) {
+      free_list_pair.first->Unlock();
+    }
+  }
+}
+
+MpPage* ScalablePageAllocator::FindFirstFitAll(size_t size_mp) {
+  FreeListSet &free_list_set = free_lists_[num_caches_];
+  for (std::pair<Mutex*, iqueue<MpPage>*> &free_list_pair :
+       free_list_set.lists_) {
+    Mutex &lock = *free_list_pair.first;
+    iqueue<MpPage> &free_list = *free_list_pair.second;
+    ScopedMutex scoped_lock(lock, 0);
+    MpPage *page = FindFirstFit(size_mp, free_list);
+    if (page) {
+      return page;
+    }
+  }
+  return nullptr;
+}
+
+MpPage* ScalablePageAllocator::AllocatePage(size_t size_mp, size_t exp) {
   MpPage *page = nullptr;
-  size_t exp;
-  size_t size_mp = RoundUp(size + sizeof(MpPage), exp);
+  ThreadCache *tcache = nullptr;
+  if (exp < num_magazines_) {
+    tcache = GetThreadCache();
+  }
 
-  // Case 1: Can we re-use an existing page?
-  page = CheckLocalCaches(size_mp, exp);
+  if (tcache) {
+    // Case 0: Check the thread's front-end cache
+    page = AllocateFromMagazine(*tcache, exp);
+  } else {
+    // Case 1: Can we re-use an existing page?
+    page = CheckLocalCaches(size_mp, exp);
+  }
 
   // Case 2: Coalesce if enough space is being wasted
-  // if (page == nullptr) {}
+  if (page == nullptr) {
+    page = CheckCoalesce(size_mp, false);
+  }
 
   // Case 3: Allocate from stack if no page found
   if (page == nullptr) {
-    auto off = alloc_.AllocateOffset(size_mp);
-    if (!off.IsNull()) {
-      page = alloc_.Convert<MpPage>(off - sizeof(MpPage));
+    if (tcache) {
+      page = CarveMagazine(*tcache, size_mp, exp);
+    } else {
+      page = AllocateFromStack(size_mp);
     }
   }
 
-  // Case 4: Completely out of memory
+  // Case 4: Coalesce before declaring out of memory
   if (page == nullptr) {
-    throw OUT_OF_MEMORY;
+    page = CheckCoalesce(size_mp, true);
+  }
+  if (page == nullptr) {
+    throw OUT_OF_MEMORY.format(size_mp, alloc_.heap_->heap_size_);
   }
 
   // Mark as allocated
-  page->page_size_ = size_mp;
-  header_->total_alloc_.fetch_add(page->page_size_);
-  auto p = Convert<MpPage, OffsetPointer>(page);
+  if (tcache) {
+    tcache->AddAlloc(page->page_size_);
+  } else {
+    header_->total_alloc_.fetch_add(page->page_size_);
+  }
+  page->flags_.Clear();
   page->SetAllocated();
-  return p + sizeof(MpPage);
+  page->off_ = 0;
+  return page;
+}
+
+OffsetPointer ScalablePageAllocator::AllocateOffset(size_t size) {
+  size_t exp;
+  size_t size_mp = RoundUp(size + sizeof(MpPage), exp);
+  MpPage *page = AllocatePage(size_mp, exp);
+  return Convert<MpPage, OffsetPointer>(page) + sizeof(MpPage);
 }
 
 OffsetPointer ScalablePageAllocator::AlignedAllocateOffset(size_t size,
                                                            size_t alignment) {
-  throw ALIGNED_ALLOC_NOT_SUPPORTED.format();
+  size_t exp;
+  size_t size_mp = RoundUp(MpPage::GetAlignedPageSize(size, alignment), exp);
+  MpPage *page = AllocatePage(size_mp, exp);
+  MpPage *hdr = MpPage::PlaceAligned(page, alignment);
+  return Convert<MpPage, OffsetPointer>(hdr) + sizeof(MpPage);
 }
 
 OffsetPointer ScalablePageAllocator::ReallocateOffsetNoNullCheck(
@@ -99,7 +506,7 @@ OffsetPointer ScalablePageAllocator::ReallocateOffsetNoNullCheck(
   void *ptr = AllocatePtr<void*, OffsetPointer>(new_size, new_p);
   MpPage *hdr = Convert<MpPage>(p - sizeof(MpPage));
   void *old = (void*)(hdr + 1);
-  memcpy(ptr, old, hdr->page_size_ - sizeof(MpPage));
+  memcpy(ptr, old, std::min(hdr->page_size_ - sizeof(MpPage), new_size));
   FreeOffsetNoNullCheck(p);
   return new_p;
 }
@@ -107,18 +514,31 @@ OffsetPointer ScalablePageAllocator::ReallocateOffsetNoNullCheck(
 void ScalablePageAllocator::FreeOffsetNoNullCheck(OffsetPointer p) {
   // Mark as free
   auto hdr_offset = p - sizeof(MpPage);
-  auto hdr = Convert<MpPage>(hdr_offset);
+  auto hdr = Convert<MpPage>(hdr_offset)->GetPageStart();
   if (!hdr->IsAllocated()) {
     throw DOUBLE_FREE.format();
   }
   hdr->UnsetAllocated();
+  size_t exp = GetFreeListSetId(hdr->page_size_);
+
+  // Append to the thread's front-end cache
+  if (exp < num_magazines_) {
+    ThreadCache *tcache = GetThreadCache();
+    if (tcache) {
+      tcache->SubAlloc(hdr->page_size_);
+      FreeToMagazine(*tcache, hdr, exp);
+      return;
+    }
+  }
   header_->total_alloc_.fetch_sub(hdr->page_size_);
-  size_t exp;
-  RoundUp(hdr->page_size_, exp);
+  size_t now = 0;
+  if (IsPurgeable(hdr->page_size_)) {
+    now = PagePurge::GetTimeMs();
+    MarkFree(hdr, now);
+  }
 
-  // Append to small buffer cache free list
-  if (hdr->page_size_ <= max_cached_size_) {
-    // Get buffer cache at exp
+  // Append to the free list for this page size
+  {
     FreeListSet &free_list_set = free_lists_[exp];
     uint16_t conc = free_list_set.rr_free_->fetch_add(1) %
       free_list_set.lists_.size();
@@ -128,17 +548,138 @@ void ScalablePageAllocator::FreeOffsetNoNullCheck(OffsetPointer p) {
     iqueue<MpPage> &free_list = *free_list_pair.second;
     ScopedMutex scoped_lock(lock, 0);
     free_list.enqueue(hdr);
+  }
+  if (now) {
+    CheckPurge(now);
+  }
+}
+
+void ScalablePageAllocator::AllocateBatch(size_t size, size_t count,
+                                          OffsetPointer *out) {
+  size_t exp;
+  size_t size_mp = RoundUp(size + sizeof(MpPage), exp);
+  if (exp >= num_caches_) {
+    Allocator::AllocateBatch(size, count, out);
+    return;
+  }
+  size_t num_pages = 0;
+
+  // Drain the thread's magazine first
+  ThreadCache *tcache = nullptr;
+  if (exp < num_magazines_) {
+    tcache = GetThreadCache();
+  }
+  if (tcache) {
+    Magazine &mag = tcache->mags_[exp];
+    while (num_pages < count && !mag.IsEmpty()) {
+      out[num_pages++] = Convert<MpPage, OffsetPointer>(mag.pop());
+    }
+  }
+
+  // Take the next set of pages from a single lane
+  if (num_pages < count) {
+    FreeListSet &free_list_set = free_lists_[exp];
+    uint16_t conc = free_list_set.rr_alloc_->fetch_add(1) %
+      free_list_set.lists_.size();
+    std::pair<Mutex*, iqueue<MpPage>*> free_list_pair =
+      free_list_set.lists_[conc];
+    Mutex &lock = *free_list_pair.first;
+    iqueue<MpPage> &free_list = *free_list_pair.second;
+    ScopedMutex scoped_lock(lock, 0);
+    while (num_pages < count && free_list.size()) {
+      out[num_pages++] = Convert<MpPage, OffsetPointer>(free_list.dequeue());
+    }
+  }
+
+  // Carve the remainder from the stack in one piece
+  if (num_pages < count) {
+    OffsetPointer off = alloc_.heap_->TryAllocateOffset(
+      (count - num_pages) * size_mp);
+    if (!off.IsNull()) {
+      for (; num_pages < count; ++num_pages) {
+        out[num_pages] = off;
+        off += size_mp;
+      }
+    }
+  }
+
+  // Mark as allocated
+  for (size_t i = 0; i < num_pages; ++i) {
+    auto page = Convert<MpPage>(out[i]);
+    page->page_size_ = size_mp;
+    page->flags_.Clear();
+    page->SetAllocated();
+    page->off_ = 0;
+    out[i] += sizeof(MpPage);
+  }
+  if (tcache) {
+    tcache->AddAlloc(num_pages * size_mp);
   } else {
-    // Get buffer cache at exp
-    FreeListSet &free_list_set = free_lists_[num_caches_];
+    header_->total_alloc_.fetch_add(num_pages * size_mp);
+  }
+
+  // The stack was exhausted, so fall back to coalescing
+  for (; num_pages < count; ++num_pages) {
+    out[num_pages] = AllocateOffset(size);
+  }
+}
+
+void ScalablePageAllocator::FreeBatch(size_t count, OffsetPointer *ptrs) {
+  ThreadCache *tcache = GetThreadCache();
+  size_t now = 0;
+  size_t i = 0;
+  while (i < count) {
+    // Mark the page as free
+    auto hdr = Convert<MpPage>(ptrs[i] - sizeof(MpPage))->GetPageStart();
+    if (!hdr->IsAllocated()) {
+      throw DOUBLE_FREE.format();
+    }
+    hdr->UnsetAllocated();
+    size_t exp = GetFreeListSetId(hdr->page_size_);
+    ++i;
+
+    // Append to the thread's front-end cache
+    if (exp < num_magazines_ && tcache) {
+      tcache->SubAlloc(hdr->page_size_);
+      FreeToMagazine(*tcache, hdr, exp);
+      continue;
+    }
+
+    // Append the run of pages in this size class to a single lane
+    if (IsPurgeable(hdr->page_size_) && now == 0) {
+      now = PagePurge::GetTimeMs();
+    }
+    FreeListSet &free_list_set = free_lists_[exp];
     uint16_t conc = free_list_set.rr_free_->fetch_add(1) %
       free_list_set.lists_.size();
     std::pair<Mutex*, iqueue<MpPage>*> free_list_pair =
       free_list_set.lists_[conc];
     Mutex &lock = *free_list_pair.first;
     iqueue<MpPage> &free_list = *free_list_pair.second;
+    size_t total_size = hdr->page_size_;
     ScopedMutex scoped_lock(lock, 0);
+    MarkFree(hdr, now);
     free_list.enqueue(hdr);
+    for (; i < count; ++i) {
+      hdr = Convert<MpPage>(ptrs[i] - sizeof(MpPage))->GetPageStart();
+      if (GetFreeListSetId(hdr->page_size_) != exp) {
+        break;
+      }
+      if (!hdr->IsAllocated()) {
+        throw DOUBLE_FREE.format();
+      }
+      hdr->UnsetAllocated();
+      total_size += hdr->page_size_;
+      if (IsPurgeable(hdr->page_size_) && now == 0) {
+        now = PagePurge::GetTimeMs();
+      }
+      MarkFree(hdr, now);
+      free_list.enqueue(hdr);
+    }
+    header_->total_alloc_.fetch_sub(total_size);
+  }
+  if (now) {
+    CheckPurge(now);
   }
 }
 
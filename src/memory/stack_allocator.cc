@@ -13,6 +13,8 @@
 
 #include <hermes_shm/memory/allocator/stack_allocator.h>
 #include <hermes_shm/memory/allocator/mp_page.h>
+#include <hermes_shm/memory/allocator/page_purge.h>
+#include <algorithm>
 
 namespace hshm::ipc {
 
@@ -24,7 +26,8 @@ void StackAllocator::shm_init(allocator_id_t id,
   buffer_size_ = buffer_size;
   header_ = reinterpret_cast<StackAllocatorHeader*>(buffer_);
   custom_header_ = reinterpret_cast<char*>(header_ + 1);
-  size_t region_off = (custom_header_ - buffer_) + custom_header_size;
+  size_t region_off = MemoryAlignment::AlignTo(
+    sizeof(MpPage), (custom_header_ - buffer_) + custom_header_size);
   size_t region_size = buffer_size_ - region_off;
   header_->Configure(id, custom_header_size, region_off, region_size);
   heap_ = &header_->heap_;
@@ -43,8 +46,18 @@ size_t StackAllocator::GetCurrentlyAllocatedSize() {
   return header_->total_alloc_;
 }
 
+size_t StackAllocator::GetResidentSize() {
+  return PagePurge::GetResidentSize(buffer_, heap_->heap_off_.load());
+}
+
+size_t StackAllocator::GetUsableSize(OffsetPointer p) {
+  auto hdr = Convert<MpPage>(p - sizeof(MpPage));
+  return hdr->page_size_ - sizeof(MpPage);
+}
+
 OffsetPointer StackAllocator::AllocateOffset(size_t size) {
-  size += sizeof(MpPage);
+  // Keep page headers aligned to their size
+  size = MemoryAlignment::AlignTo(sizeof(MpPage), size + sizeof(MpPage));
   OffsetPointer p = heap_->AllocateOffset(size);
   auto hdr = Convert<MpPage>(p);
   hdr->SetAllocated();
@@ -56,7 +69,32 @@ OffsetPointer StackAllocator::AllocateOffset(size_t size) {
 
 OffsetPointer StackAllocator::AlignedAllocateOffset(size_t size,
                                                     size_t alignment) {
-  throw ALIGNED_ALLOC_NOT_SUPPORTED.format();
+  size_t page_size = MemoryAlignment::AlignTo(
+    sizeof(MpPage), MpPage::GetAlignedPageSize(size, alignment));
+  OffsetPointer p = heap_->AllocateOffset(page_size);
+  auto page = Convert<MpPage>(p);
+  page->SetAllocated();
+  page->page_size_ = page_size;
+  page->off_ = 0;
+  header_->total_alloc_.fetch_add(page->page_size_);
+  MpPage *hdr = MpPage::PlaceAligned(page, alignment);
+  return Convert<MpPage, OffsetPointer>(hdr) + sizeof(MpPage);
+}
+
+void StackAllocator::AllocateBatch(size_t size, size_t count,
+                                   OffsetPointer *out) {
+  size = MemoryAlignment::AlignTo(sizeof(MpPage), size + sizeof(MpPage));
+  OffsetPointer p = heap_->AllocateOffset(size * count);
+  for (size_t i = 0; i < count; ++i) {
+    auto hdr = Convert<MpPage>(p);
+    hdr->flags_.Clear();
+    hdr->SetAllocated();
+    hdr->page_size_ = size;
+    hdr->off_ = 0;
+    out[i] = p + sizeof(MpPage);
+    p += size;
+  }
+  header_->total_alloc_.fetch_add(size * count);
 }
 
 OffsetPointer StackAllocator::ReallocateOffsetNoNullCheck(OffsetPointer p,
@@ -66,18 +104,35 @@ OffsetPointer StackAllocator::ReallocateOffsetNoNullCheck(OffsetPointer p,
   auto hdr = Convert<MpPage>(p - sizeof(MpPage));
   size_t old_size = hdr->page_size_ - sizeof(MpPage);
   void *dst = AllocatePtr<void, OffsetPointer>(new_size, new_p);
-  memcpy((void*)dst, (void*)src, old_size);
+  memcpy((void*)dst, (void*)src, std::min(old_size, new_size));
   Free(p);
   return new_p;
 }
 
 void StackAllocator::FreeOffsetNoNullCheck(OffsetPointer p) {
-  auto hdr = Convert<MpPage>(p - sizeof(MpPage));
+  auto hdr = Convert<MpPage>(p - sizeof(MpPage))->GetPageStart();
   if (!hdr->IsAllocated()) {
     throw DOUBLE_FREE.format();
   }
   hdr->UnsetAllocated();
   header_->total_alloc_.fetch_sub(hdr->page_size_);
+  PagePurge::Release(reinterpret_cast<char*>(hdr + 1),
+                     hdr->page_size_ - sizeof(MpPage));
+}
+
+void StackAllocator::FreeBatch(size_t count, OffsetPointer *ptrs) {
+  size_t total_size = 0;
+  for (size_t i = 0; i < count; ++i) {
+    auto hdr = Convert<MpPage>(ptrs[i] - sizeof(MpPage))->GetPageStart();
+    if (!hdr->IsAllocated()) {
+      throw DOUBLE_FREE.format();
+    }
+    hdr->UnsetAllocated();
+    total_size += hdr->page_size_;
+    PagePurge::Release(reinterpret_cast<char*>(hdr + 1),
+                       hdr->page_size_ - sizeof(MpPage));
+  }
+  header_->total_alloc_.fetch_sub(total_size);
 }
 
 }  // namespace hshm::ipc
@@ -104,13 +104,16 @@ void ReallocationTest(Allocator *alloc) {
 }
 
 void AlignedAllocationTest(Allocator *alloc) {
-  std::vector<std::pair<size_t, size_t>> sizes = {
-      {KILOBYTES(4), KILOBYTES(4)},
+  // (size, alignment, count)
+  std::vector<std::tuple<size_t, size_t, size_t>> sizes = {
+      {KILOBYTES(4), KILOBYTES(4), 1024},
+      {100, 64, 1024},
+      {KILOBYTES(1), MEGABYTES(2), 64},
   };
 
   // Aligned allocate pages
-  for (auto &[size, alignment] : sizes) {
-    for (size_t i = 0; i < 1024; ++i) {
+  for (auto &[size, alignment, count] : sizes) {
+    for (size_t i = 0; i < count; ++i) {
       Pointer p;
       char *ptr = alloc->AllocatePtr<char>(size, p, alignment);
       REQUIRE(((size_t)ptr % alignment) == 0);
@@ -120,11 +123,43 @@ void AlignedAllocationTest(Allocator *alloc) {
   }
 }
 
+void BatchAllocationTest(Allocator *alloc) {
+  std::vector<size_t> sizes = {64, KILOBYTES(4), MEGABYTES(1)};
+  size_t count = 64;
+
+  for (size_t size : sizes) {
+    // Allocate a batch and verify each page is usable and distinct
+    std::vector<hipc::OffsetPointer> ps(count);
+    alloc->AllocateBatch(size, count, ps.data());
+    for (size_t i = 0; i < count; ++i) {
+      REQUIRE(!ps[i].IsNull());
+      memset(alloc->Convert<char>(ps[i]), (char)i, size);
+    }
+    for (size_t i = 0; i < count; ++i) {
+      REQUIRE(VerifyBuffer(alloc->Convert<char>(ps[i]), size, (char)i));
+    }
+
+    // Free half individually and the rest as a batch
+    for (size_t i = 0; i < count / 2; ++i) {
+      alloc->FreeOffsetNoNullCheck(ps[i]);
+    }
+    alloc->FreeBatch(count / 2, ps.data() + count / 2);
+  }
+}
+
 TEST_CASE("StackAllocator") {
   auto alloc = Pretest<hipc::PosixShmMmap, hipc::StackAllocator>();
   REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
   PageAllocationTest(alloc);
   REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  AlignedAllocationTest(alloc);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  BatchAllocationTest(alloc);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
   Posttest();
 }
 
@@ -138,6 +173,14 @@ TEST_CASE("MallocAllocator") {
   MultiPageAllocationTest(alloc);
   REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
 
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  AlignedAllocationTest(alloc);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  BatchAllocationTest(alloc);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+
   Posttest();
 }
 
@@ -155,6 +198,138 @@ TEST_CASE("ScalablePageAllocator") {
   ReallocationTest(alloc);
   REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
 
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  AlignedAllocationTest(alloc);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  BatchAllocationTest(alloc);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+
+  Posttest();
+}
+
+TEST_CASE("ScalablePageAllocatorSizeClasses") {
+  using hipc::PageSizeClasses;
+  REQUIRE(PageSizeClasses::GetSize(0) == 64);
+  REQUIRE(PageSizeClasses::GetSize(PageSizeClasses::count_ - 1) ==
+          MEGABYTES(16));
+  for (size_t cls = 1; cls < PageSizeClasses::count_; ++cls) {
+    size_t size = PageSizeClasses::GetSize(cls);
+    size_t prior = PageSizeClasses::GetSize(cls - 1);
+    REQUIRE(size > prior);
+    REQUIRE(size % 16 == 0);
+    // Classes waste at most a quarter of the request
+    REQUIRE(size - prior <= prior / 4 + 16);
+    REQUIRE(PageSizeClasses::GetClass(size) == cls);
+    REQUIRE(PageSizeClasses::GetClass(prior + 1) == cls);
+  }
+  for (size_t size = 1; size <= 64; ++size) {
+    REQUIRE(PageSizeClasses::GetClass(size) == 0);
+  }
+}
+
+TEST_CASE("ScalablePageAllocatorCoalesce") {
+  // Coalesce whenever a request misses the free lists
+  auto alloc = Pretest<hipc::PosixShmMmap, hipc::ScalablePageAllocator>(
+    hshm::RealNumber(0, 1), 0);
+  auto page_alloc = reinterpret_cast<hipc::ScalablePageAllocator*>(alloc);
+  size_t count = 64;
+  std::vector<Pointer> ps(count);
+
+  // Free a set of large pages
+  for (size_t i = 0; i < count; ++i) {
+    ps[i] = alloc->Allocate(MEGABYTES(1));
+  }
+  size_t footprint = page_alloc->GetFootprint();
+  for (size_t i = 0; i < count; ++i) {
+    alloc->Free(ps[i]);
+  }
+
+  // Small pages should re-use the space of the large pages
+  ps.resize(count * KILOBYTES(1) / 2);
+  for (size_t i = 0; i < ps.size(); ++i) {
+    ps[i] = alloc->Allocate(KILOBYTES(1));
+  }
+  REQUIRE(page_alloc->GetFootprint() <= footprint);
+  for (size_t i = 0; i < ps.size(); ++i) {
+    alloc->Free(ps[i]);
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  Posttest();
+}
+
+TEST_CASE("FixedPageAllocator") {
+  auto alloc = Pretest<hipc::PosixShmMmap, hipc::FixedPageAllocator>(
+    KILOBYTES(4));
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  PageAllocationTest(alloc);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+
+  // Freed pages are reused
+  Pointer p1 = alloc->Allocate(KILOBYTES(1));
+  alloc->Free(p1);
+  Pointer p2 = alloc->Allocate(KILOBYTES(4));
+  REQUIRE(p1 == p2);
+
+  // Pages are naturally aligned to their size
+  Pointer p3;
+  char *ptr = alloc->AllocatePtr<char>(KILOBYTES(4), p3, KILOBYTES(4));
+  REQUIRE(((size_t)ptr % KILOBYTES(4)) == 0);
+
+  // Pages cannot grow
+  REQUIRE_THROWS(alloc->Allocate(KILOBYTES(4) + 1));
+  REQUIRE_THROWS(alloc->Allocate(KILOBYTES(4), KILOBYTES(8)));
+  alloc->Free(p2);
+  alloc->Free(p3);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  Posttest();
+}
+
+void PurgeTest(Allocator *alloc) {
+  size_t count = 16;
+  size_t page_size = MEGABYTES(4);
+  std::vector<Pointer> ps(count);
+
+  // Touch a set of large pages
+  for (size_t i = 0; i < count; ++i) {
+    char *ptr = alloc->AllocatePtr<char>(page_size, ps[i]);
+    memset(ptr, 1, page_size);
+  }
+  size_t resident = alloc->GetResidentSize();
+  REQUIRE(resident >= count * page_size);
+
+  // Freed pages should no longer be resident once purged
+  for (size_t i = 0; i < count; ++i) {
+    alloc->Free(ps[i]);
+  }
+  alloc->Purge();
+  REQUIRE(alloc->GetResidentSize() <= resident - count * (page_size / 2));
+
+  // Purged pages can be re-used
+  for (size_t i = 0; i < count; ++i) {
+    char *ptr = alloc->AllocatePtr<char>(page_size, ps[i]);
+    memset(ptr, (char)i, page_size);
+  }
+  for (size_t i = 0; i < count; ++i) {
+    REQUIRE(VerifyBuffer(alloc->Convert<char>(ps[i]), page_size, (char)i));
+    alloc->Free(ps[i]);
+  }
+}
+
+TEST_CASE("StackAllocatorPurge") {
+  auto alloc = Pretest<hipc::PosixShmMmap, hipc::StackAllocator>();
+  PurgeTest(alloc);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  Posttest();
+}
+
+TEST_CASE("ScalablePageAllocatorPurge") {
+  // Purge pages as soon as they are free
+  auto alloc = Pretest<hipc::PosixShmMmap, hipc::ScalablePageAllocator>(
+    hshm::RealNumber(1, 5), MEGABYTES(1), 0);
+  PurgeTest(alloc);
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
   Posttest();
 }
 
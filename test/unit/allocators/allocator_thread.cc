@@ -46,3 +46,21 @@ TEST_CASE("ScalablePageAllocatorMultithreaded") {
   REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
   Posttest();
 }
+
+TEST_CASE("FixedPageAllocatorMultithreaded") {
+  auto alloc = Pretest<hipc::PosixShmMmap, hipc::FixedPageAllocator>(
+    KILOBYTES(4));
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  size_t nthreads = 8;
+  omp_set_dynamic(0);
+#pragma omp parallel shared(alloc) num_threads(nthreads)
+  {
+#pragma omp barrier
+    for (int i = 0; i < 16; ++i) {
+      PageAllocationTest(alloc);
+    }
+#pragma omp barrier
+  }
+  REQUIRE(alloc->GetCurrentlyAllocatedSize() == 0);
+  Posttest();
+}
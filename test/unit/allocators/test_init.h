@@ -32,8 +32,8 @@ struct SimpleAllocatorHeader {
   int checksum_;
 };
 
-template<typename BackendT, typename AllocT>
-Allocator* Pretest() {
+template<typename BackendT, typename AllocT, typename ...Args>
+Allocator* Pretest(Args&& ...args) {
   std::string shm_url = "test_allocators";
   allocator_id_t alloc_id(0, 1);
   auto mem_mngr = HERMES_MEMORY_MANAGER;
@@ -42,7 +42,8 @@ Allocator* Pretest() {
   mem_mngr->CreateBackend<BackendT>(
     GIGABYTES(1), shm_url);
   mem_mngr->CreateAllocator<AllocT>(
-    shm_url, alloc_id, sizeof(SimpleAllocatorHeader));
+    shm_url, alloc_id, sizeof(SimpleAllocatorHeader),
+    std::forward<Args>(args)...);
   auto alloc = mem_mngr->GetAllocator(alloc_id);
   auto hdr = alloc->GetCustomHeader<SimpleAllocatorHeader>();
   hdr->checksum_ = HEADER_CHECKSUM;
@@ -13,8 +13,10 @@
 #include "basic_test.h"
 
 #include "hermes_shm/memory/backend/posix_shm_mmap.h"
+#include "hermes_shm/memory/backend/posix_shm_huge_mmap.h"
 
 using hshm::ipc::PosixShmMmap;
+using hshm::ipc::PosixShmHugeMmap;
 
 TEST_CASE("BackendReserve") {
   PosixShmMmap b1;
@@ -28,3 +30,25 @@ TEST_CASE("BackendReserve") {
   // Destroy SHMEM
   b1.shm_destroy();
 }
+
+TEST_CASE("HugePageBackend") {
+  PosixShmHugeMmap b1;
+  size_t huge_page_size = PosixShmHugeMmap::huge_page_size_;
+
+  // Sizes are rounded up to huge pages, and data is aligned to them
+  REQUIRE(b1.shm_init(MEGABYTES(63), "shmem_huge_test"));
+  REQUIRE(b1.data_size_ == MEGABYTES(64));
+  REQUIRE((size_t)b1.data_ % huge_page_size == 0);
+  memset(b1.data_, 7, b1.data_size_);
+
+  // Attach from another backend
+  PosixShmHugeMmap b2;
+  REQUIRE(b2.shm_deserialize("shmem_huge_test"));
+  REQUIRE(b2.IsHugetlb() == b1.IsHugetlb());
+  REQUIRE(b2.data_size_ == b1.data_size_);
+  REQUIRE(VerifyBuffer(b2.data_, b2.data_size_, 7));
+  b2.shm_detach();
+
+  // Destroy SHMEM
+  b1.shm_destroy();
+}
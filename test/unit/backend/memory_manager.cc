@@ -78,3 +78,93 @@ TEST_CASE("MemoryManager") {
 
   HERMES_ERROR_HANDLE_END()
 }
+
+TEST_CASE("FileMmapRestart") {
+  char nonce = 5;
+  size_t page_size = KILOBYTES(4);
+  size_t num_pages = 64;
+  std::string path = "/tmp/test_file_mmap_backend";
+  allocator_id_t alloc_id(0, 3);
+  auto mem_mngr = HERMES_MEMORY_MANAGER;
+
+  // Build pages in a file-backed allocator
+  mem_mngr->CreateBackend<hipc::FileMmap>(MEGABYTES(64), path);
+  auto alloc = reinterpret_cast<hipc::ScalablePageAllocator*>(
+    mem_mngr->CreateAllocator<hipc::ScalablePageAllocator>(
+      path, alloc_id, sizeof(SimpleHeader)));
+  hipc::Pointer pages = alloc->Allocate(sizeof(hipc::Pointer) * num_pages);
+  auto page_ptrs = alloc->Convert<hipc::Pointer>(pages);
+  for (size_t i = 0; i < num_pages; ++i) {
+    char *page = alloc->AllocatePtr<char>(page_size, page_ptrs[i]);
+    memset(page, nonce + i, page_size);
+  }
+  alloc->GetCustomHeader<SimpleHeader>()->p_ = pages;
+  size_t alloc_size = alloc->GetCurrentlyAllocatedSize();
+  alloc->FlushThreadCache();
+  auto backend = reinterpret_cast<hipc::FileMmap*>(mem_mngr->GetBackend(path));
+  backend->Checkpoint();
+
+  // Simulate a restart by dropping the mapping entirely
+  mem_mngr->UnregisterAllocator(alloc_id);
+  mem_mngr->UnregisterBackend(path);
+  REQUIRE(access(path.c_str(), F_OK) == 0);
+
+  // Re-attaching the file re-hydrates the allocator
+  mem_mngr->AttachBackend(MemoryBackendType::kFileMmap, path);
+  hipc::Allocator *alloc2 = mem_mngr->GetAllocator(alloc_id);
+  REQUIRE(alloc2 != nullptr);
+  REQUIRE(dynamic_cast<hipc::ScalablePageAllocator*>(alloc2) != nullptr);
+  REQUIRE(alloc2->GetCurrentlyAllocatedSize() == alloc_size);
+  page_ptrs = alloc2->Convert<hipc::Pointer>(
+    alloc2->GetCustomHeader<SimpleHeader>()->p_);
+  for (size_t i = 0; i < num_pages; ++i) {
+    char *page = alloc2->Convert<char>(page_ptrs[i]);
+    REQUIRE(VerifyBuffer(page, page_size, nonce + i));
+    alloc2->Free(page_ptrs[i]);
+  }
+
+  // The allocator keeps working after the restart
+  char *page = alloc2->AllocatePtr<char>(page_size);
+  memset(page, nonce, page_size);
+  REQUIRE(VerifyBuffer(page, page_size, nonce));
+
+  // Destroying the backend removes the file
+  mem_mngr->UnregisterAllocator(alloc_id);
+  mem_mngr->DestroyBackend(path);
+  REQUIRE(access(path.c_str(), F_OK) != 0);
+}
+
+TEST_CASE("MemoryManagerFindAllocator") {
+  size_t num_allocs = 4;
+  size_t slice_size = MEGABYTES(1);
+  auto mem_mngr = HERMES_MEMORY_MANAGER;
+  std::vector<char> region(num_allocs * slice_size);
+  std::vector<hipc::StackAllocator> allocs(num_allocs);
+
+  // Register allocators over adjacent slices, in reverse address order
+  for (size_t i = num_allocs; i-- > 0;) {
+    allocs[i].shm_init(allocator_id_t(1, i), 0,
+                       region.data() + i * slice_size, slice_size);
+    mem_mngr->RegisterAllocator(&allocs[i]);
+  }
+
+  // Pointers resolve to the allocator whose buffer contains them
+  for (size_t i = 0; i < num_allocs; ++i) {
+    char *page = allocs[i].AllocatePtr<char>(KILOBYTES(4));
+    REQUIRE(mem_mngr->FindAllocator(page) == &allocs[i]);
+    hipc::Pointer p = mem_mngr->Convert<char>(page);
+    REQUIRE(p.allocator_id_ == allocator_id_t(1, i));
+    REQUIRE(mem_mngr->Convert<char>(p) == page);
+    char *last = allocs[i].GetBuffer() + slice_size - 1;
+    REQUIRE(mem_mngr->FindAllocator(last) == &allocs[i]);
+  }
+  char *end = region.data() + num_allocs * slice_size;
+  REQUIRE(mem_mngr->FindAllocator(end) != &allocs[num_allocs - 1]);
+
+  // Unregistered allocators are no longer found
+  for (size_t i = 0; i < num_allocs; ++i) {
+    mem_mngr->UnregisterAllocator(allocator_id_t(1, i));
+    REQUIRE(mem_mngr->FindAllocator(allocs[i].GetBuffer()) == nullptr);
+    REQUIRE(mem_mngr->Convert<char>(allocs[i].GetBuffer()).IsNull());
+  }
+}